@@ -0,0 +1,39 @@
+#include "arena.h"
+
+#include <cstdio>
+
+void arena_init(Arena& arena, size_t capacity)
+{
+    arena.base = new uint8_t[capacity];
+    arena.capacity = capacity;
+    arena.used = 0;
+    arena.high_water = 0;
+}
+
+void arena_destroy(Arena& arena)
+{
+    delete[] arena.base;
+    arena = {};
+}
+
+void* arena_alloc(Arena& arena, size_t size, size_t align)
+{
+    uintptr_t address = (uintptr_t)(arena.base + arena.used);
+    size_t padding = (align - (address & (align - 1))) & (align - 1);
+
+    if(size + padding > arena.capacity - arena.used)
+    {
+        fprintf(stderr, "Error: arena out of memory (%zu of %zu bytes used, %zu requested)\n", arena.used, arena.capacity, size);
+        return NULL;
+    }
+
+    void* ptr = arena.base + arena.used + padding;
+    arena.used += padding + size;
+    if(arena.used > arena.high_water) arena.high_water = arena.used;
+    return ptr;
+}
+
+void arena_reset(Arena& arena, size_t mark)
+{
+    arena.used = mark;
+}
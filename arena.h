@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t ARENA_DEFAULT_ALIGN = 16;
+
+// Linear allocator over one fixed block. Allocations are bumped off the end
+// and never freed individually; arena_reset rolls back to a mark in O(1), so
+// memory laid out after the mark can be rebuilt without touching the heap.
+struct Arena
+{
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+    // Largest used seen, for sizing the block
+    size_t high_water;
+};
+
+void arena_init(Arena& arena, size_t capacity);
+void arena_destroy(Arena& arena);
+
+// Returns NULL if the arena is full; align must be a power of two
+void* arena_alloc(Arena& arena, size_t size, size_t align = ARENA_DEFAULT_ALIGN);
+
+template <typename T>
+T* arena_alloc_array(Arena& arena, size_t count)
+{
+    size_t align = alignof(T) > ARENA_DEFAULT_ALIGN ? alignof(T) : ARENA_DEFAULT_ALIGN;
+    return (T*)arena_alloc(arena, count * sizeof(T), align);
+}
+
+// Bytes an allocation of size can take, including worst-case padding
+constexpr size_t arena_size_for(size_t size, size_t align = ARENA_DEFAULT_ALIGN)
+{
+    return size + align - 1;
+}
+
+inline size_t arena_mark(const Arena& arena)
+{
+    return arena.used;
+}
+
+// Releases everything allocated after mark
+void arena_reset(Arena& arena, size_t mark = 0);
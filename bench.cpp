@@ -0,0 +1,1276 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+#include "capture.h"
+#include "env.h"
+#include "game.h"
+#include "input.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "replay.h"
+#include "snapshot.h"
+
+// Headless benchmark: runs the frame loop without a window and reports
+// throughput, time per phase and a checksum of the final frame.
+//
+//   ./bench --headless --ticks 10000 [--render-every N]
+//   ./bench --headless --collision
+//   ./bench --headless --bands [--render-threads N]
+//   ./bench --headless --pipeline --ticks 300
+//   ./bench --headless --ticks 10000 --record session.sirp
+//   ./bench --headless --ticks 3000 --capture frames.sifs [--capture-every N]
+//   ./bench --headless --verify-capture frames.sifs
+//   ./bench --headless --replay session.sirp
+//   ./bench --headless --restart --ticks 3000
+//   ./bench --headless --wave --ticks 3000
+//   ./bench --headless --rollback 8 --ticks 3000
+//   ./bench --headless --dirty --ticks 3000
+//   ./bench --headless --envs 1024 --ticks 600 [--env-threads N] [--env-render]
+//   ./bench --headless --stress [--width N] [--height N] [--rows N] [--cols N] [--bullets N]
+//
+// --full-redraw turns off dirty-rectangle tracking, so every frame clears
+// and redraws the whole buffer. --indexed renders palette indices instead
+// of colours (not with --bands); the checksum is of the expanded frame, so
+// it matches the colour run.
+//
+// --capture writes frames on a background thread, to a frame stream or,
+// for a path ending in .png, to one PNG per frame named by a printf
+// pattern. The loop runs uncapped, so frames the writer cannot keep up with
+// are dropped; --verify-capture replays the scripted session and checks
+// every frame in a stream against a fresh render of its tick.
+//
+// --stress builds the world at a 3840x2160 playfield, a 100x100 formation
+// and 100000 bullets, or the sizes given, and times each phase of the
+// frame over 300 ticks unless --ticks says otherwise. With --dirty it runs
+// the dirty-rectangle check at those sizes instead, which also fails if the
+// dirty path is slower than a full redraw.
+//
+// --profile prints the per-zone profiler histograms on exit and
+// --trace PATH writes the recent samples as a Chrome trace.
+//
+// The simulation runs uncapped on the fixed tick, so the sim checksum must be
+// the same for any --render-every; only the buffer checksum depends on it.
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Every heap allocation in the process goes through here, so a phase can
+// check it did not allocate
+static std::atomic<size_t> heap_allocations(0);
+
+void* operator new(size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+// C++14 sized deallocation would otherwise reach the library's versions,
+// which do not know this memory came from malloc
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+enum BenchPhase
+{
+    PHASE_ALIEN_MOVE,
+    PHASE_ANIMATION,
+    PHASE_ALIEN_SIM,
+    PHASE_BULLET_SIM,
+    PHASE_PLAYER_SIM,
+    PHASE_EVENTS,
+    PHASE_DRAW,
+    NUM_PHASES
+};
+
+static const char* phase_names[NUM_PHASES] = {
+    "alien_move",
+    "animation",
+    "alien_sim",
+    "bullet_sim",
+    "player_sim",
+    "events",
+    "draw"
+};
+
+// Scripted input so every run sees the same workload: sweep left and right
+// across the field and fire every few ticks.
+Input scripted_input(size_t tick)
+{
+    Input input = {};
+    input.move_dir = (tick / 120) % 2 ? -1 : 1;
+    input.fire_pressed = tick % 8 == 0;
+    return input;
+}
+
+uint64_t buffer_checksum(const Buffer& buffer)
+{
+    // FNV-1a over the pixel data
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t* bytes = (const uint8_t*)buffer.data;
+    for(size_t i = 0; i < buffer.width * buffer.height * sizeof(uint32_t); ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Checksum of the frame as it would look on screen, expanding an indexed
+// frame through the palette first so both modes give the same value
+uint64_t frame_checksum(World& world)
+{
+    if(world.indexed) indexed_buffer_resolve(world.indexed_buffer, world.palette, &world.buffer);
+    return buffer_checksum(world.buffer);
+}
+
+// Bullet-vs-alien cost as the alien count grows: the brute-force pair loop
+// against the grid broadphase, with the same bullets and the same hits.
+void run_collision_bench(const SpriteAtlas& atlas)
+{
+    const size_t num_bullets = GAME_MAX_BULLETS;
+    const size_t num_rounds = 200;
+    const size_t alien_counts[] = {66, 256, 1024, 4096, 16384};
+    const PackedSprite& alien_sprite = atlas.frames[SPRITE_ALIEN_B_0];
+    const PackedSprite& bullet_sprite = atlas.frames[SPRITE_BULLET];
+
+    Arena bullet_arena;
+    arena_init(bullet_arena, bullet_store_bytes(num_bullets, num_bullets));
+    BulletStore bullets;
+    bullet_store_init(bullets, num_bullets, bullet_arena, num_bullets);
+    uint32_t seed = 1;
+    for(size_t bi = 0; bi < num_bullets; ++bi)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        int16_t x = (seed >> 8) % buffer_width;
+        seed = seed * 1664525u + 1013904223u;
+        int16_t y = (seed >> 8) % (buffer_height - bullet_sprite.height);
+        bullets_spawn(bullets, x, y, 2);
+    }
+
+    printf("aliens,bullets,brute_ns,grid_ns,hits\n");
+    for(size_t n : alien_counts)
+    {
+        // Spread the formation evenly over the playfield
+        size_t cols = 1;
+        while(cols * cols * buffer_height < n * buffer_width) ++cols;
+        size_t rows = (n + cols - 1) / cols;
+
+        Arena arena;
+        arena_init(arena, alien_store_bytes(n));
+        AlienStore aliens;
+        alien_store_init(aliens, n, arena);
+        for(size_t ai = 0; ai < n; ++ai)
+        {
+            aliens.x[ai] = (ai % cols) * buffer_width / cols;
+            aliens.y[ai] = (ai / cols) * buffer_height / rows;
+            aliens.type[ai] = ALIEN_TYPE_B;
+        }
+
+        SpatialGrid grid;
+        grid_init(grid, buffer_width, buffer_height, ALIEN_GRID_CELL_SIZE);
+        for(size_t ai = 0; ai < n; ++ai)
+        {
+            grid_insert(grid, ai, aliens.x[ai], aliens.y[ai], alien_sprite.width, alien_sprite.height);
+        }
+
+        size_t brute_hits = 0;
+        bench_clock::time_point start = bench_clock::now();
+        for(size_t round = 0; round < num_rounds; ++round)
+        {
+            for(size_t bi = 0; bi < num_bullets; ++bi)
+            {
+                for(size_t ai = 0; ai < n; ++ai)
+                {
+                    if(sprite_overlap_check(bullet_sprite, bullets.x[bi], bullets.y[bi], alien_sprite, aliens.x[ai], aliens.y[ai]))
+                    {
+                        ++brute_hits;
+                        break;
+                    }
+                }
+            }
+        }
+        double brute_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num_rounds;
+
+        size_t grid_hits = 0;
+        start = bench_clock::now();
+        for(size_t round = 0; round < num_rounds; ++round)
+        {
+            for(size_t bi = 0; bi < num_bullets; ++bi)
+            {
+                GridCellRange range;
+                if(!grid_cell_range(grid, bullets.x[bi], bullets.y[bi], bullet_sprite.width, bullet_sprite.height, range)) continue;
+
+                bool hit = false;
+                for(size_t row = range.row_begin; row < range.row_end && !hit; ++row)
+                {
+                    for(size_t col = range.col_begin; col < range.col_end && !hit; ++col)
+                    {
+                        size_t count;
+                        const uint32_t* cell = grid_cell(grid, col, row, count);
+                        for(size_t i = 0; i < count && !hit; ++i)
+                        {
+                            size_t ai = cell[i];
+                            hit = sprite_overlap_check(bullet_sprite, bullets.x[bi], bullets.y[bi], alien_sprite, aliens.x[ai], aliens.y[ai]);
+                        }
+                    }
+                }
+                grid_hits += hit;
+            }
+        }
+        double grid_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num_rounds;
+
+        if(brute_hits != grid_hits)
+        {
+            fprintf(stderr, "Hit mismatch with %zu aliens: brute %zu, grid %zu\n", n, brute_hits, grid_hits);
+        }
+
+        printf("%zu,%zu,%.0f,%.0f,%zu\n", n, num_bullets, brute_ns, grid_ns, grid_hits / num_rounds);
+
+        grid_destroy(grid);
+        arena_destroy(arena);
+    }
+    arena_destroy(bullet_arena);
+}
+
+// Frame time of the banded renderer as the band count grows, checked
+// against the single-threaded output
+void run_band_bench(World& world, size_t num_threads)
+{
+    const size_t num_frames = 200;
+    const size_t band_counts[] = {1, 2, 4, 8, 16, 32, 64};
+
+    world_build_draw_list(world, 1.0);
+    render_draw_list(&world.buffer, world.draw_list, world_color(world, PALETTE_BACKGROUND));
+    uint64_t reference = buffer_checksum(world.buffer);
+
+    bench_clock::time_point start = bench_clock::now();
+    for(size_t frame = 0; frame < num_frames; ++frame)
+    {
+        render_draw_list(&world.buffer, world.draw_list, world_color(world, PALETTE_BACKGROUND));
+    }
+    double single_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num_frames;
+
+    printf("threads,bands,frame_ns,match\n");
+    printf("1,1,%.0f,1\n", single_ns);
+
+    for(size_t num_bands : band_counts)
+    {
+        BandRenderer renderer;
+        band_renderer_init(renderer, num_threads, num_bands);
+
+        start = bench_clock::now();
+        for(size_t frame = 0; frame < num_frames; ++frame)
+        {
+            render_draw_list_banded(renderer, &world.buffer, world.draw_list, world_color(world, PALETTE_BACKGROUND));
+        }
+        double frame_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num_frames;
+        bool match = buffer_checksum(world.buffer) == reference;
+
+        printf("%zu,%zu,%.0f,%d\n", thread_pool_size(renderer.pool), num_bands, frame_ns, match);
+        if(!match) fprintf(stderr, "Banded output differs with %zu bands\n", num_bands);
+
+        band_renderer_destroy(renderer);
+    }
+}
+
+// Tops the bullet pool back up to its cap with bullets at random spots,
+// half of them going each way
+static void stress_refill_bullets(World& world, uint32_t& seed)
+{
+    BulletStore& bullets = world.game.bullets;
+    const GameConfig& config = world.config;
+    const int bullet_height = world.atlas->frames[SPRITE_BULLET].height;
+    while(bullets.count < bullets.max_count)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        int16_t x = (seed >> 8) % config.width;
+        seed = seed * 1664525u + 1013904223u;
+        int16_t y = bullet_height + (seed >> 8) % (config.height - 2 * bullet_height);
+        if(!bullets_spawn(bullets, x, y, seed & 0x80000000u ? 2 : -2)) break;
+    }
+}
+
+// Dirty-rectangle rendering against a full redraw of the same draw list
+// into a second buffer of the same format, every tick. The buffers must
+// match on every frame. Under stress the bullet pool is refilled every
+// tick, and the dirty path must also be no slower than the full redraw on
+// average, within timing noise.
+int run_dirty_bench(World& world, size_t num_ticks, bool stress)
+{
+    Buffer reference;
+    reference.width = world.buffer.width;
+    reference.height = world.buffer.height;
+    reference.data = new uint32_t[reference.width * reference.height];
+
+    IndexedBuffer indexed_reference;
+    indexed_reference.width = world.indexed_buffer.width;
+    indexed_reference.height = world.indexed_buffer.height;
+    indexed_reference.data = new uint8_t[indexed_reference.width * indexed_reference.height];
+
+    double dirty_ns = 0.0, full_ns = 0.0;
+    size_t dirty_pixels = 0, full_redraws = 0, mismatches = 0;
+
+    uint32_t seed = 1;
+    for(size_t tick = 0; tick < num_ticks; ++tick)
+    {
+        if(stress) stress_refill_bullets(world, seed);
+        world_tick(world, scripted_input(tick));
+        world_build_draw_list(world, 1.0);
+
+        bench_clock::time_point start = bench_clock::now();
+        world_render(world);
+        bench_clock::time_point mid = bench_clock::now();
+        if(world.indexed)
+        {
+            render_draw_list(&indexed_reference, world.draw_list, world_color(world, PALETTE_BACKGROUND));
+        }
+        else
+        {
+            render_draw_list(&reference, world.draw_list, world_color(world, PALETTE_BACKGROUND));
+        }
+        bench_clock::time_point end = bench_clock::now();
+
+        dirty_ns += std::chrono::duration<double, std::nano>(mid - start).count();
+        full_ns += std::chrono::duration<double, std::nano>(end - mid).count();
+        dirty_pixels += world.dirty.dirty_pixels;
+        full_redraws += world.dirty.full;
+        if(world.indexed)
+        {
+            mismatches += memcmp(world.indexed_buffer.data, indexed_reference.data, reference.width * reference.height) != 0;
+        }
+        else
+        {
+            mismatches += buffer_checksum(world.buffer) != buffer_checksum(reference);
+        }
+    }
+
+    size_t num_pixels = reference.width * reference.height;
+    printf("ticks: %zu\n", num_ticks);
+    printf("ns_per_frame.dirty: %.1f\n", num_ticks ? dirty_ns / num_ticks : 0.0);
+    printf("ns_per_frame.full: %.1f\n", num_ticks ? full_ns / num_ticks : 0.0);
+    printf("dirty_fraction: %.4f\n", num_ticks ? (double)dirty_pixels / num_pixels / num_ticks : 0.0);
+    printf("full_redraws: %zu\n", full_redraws);
+    printf("mismatched_frames: %zu\n", mismatches);
+    // The dirty path renders first and warms the draw list for the full
+    // one, so when both end up doing a full redraw it gets a little slack
+    bool fast_enough = !stress || dirty_ns <= full_ns * 1.05;
+    if(stress) printf("dirty_not_slower: %d\n", fast_enough);
+
+    delete[] reference.data;
+    delete[] indexed_reference.data;
+    return !mismatches && fast_enough ? 0 : 1;
+}
+
+// Turns a change of held direction into release and press events
+static void push_move(InputQueue& queue, int from, int to, uint64_t now_ns)
+{
+    if(from == to) return;
+    if(from) input_queue_push(queue, {now_ns, 0, from < 0 ? INPUT_LEFT_RELEASE : INPUT_RIGHT_RELEASE});
+    if(to) input_queue_push(queue, {now_ns, 0, to < 0 ? INPUT_LEFT_PRESS : INPUT_RIGHT_PRESS});
+}
+
+// Simulation on its own thread at the real tick rate while this thread
+// renders the newest snapshot as fast as it can, as main does minus the
+// present. Scripted input goes through the event queue, and the latency
+// from each event to the end of the first frame drawn with it lands in the
+// profiler's input_latency zone. Runs until the simulation reaches num_ticks.
+void run_pipeline_bench(World& world, size_t num_ticks)
+{
+    SnapshotTripleBuffer snapshots;
+    triple_buffer_init(snapshots, world.game.aliens.count, world.game.bullets.max_count);
+
+    // Too big for the stack with the rest of the bench
+    static InputQueue input, consumed;
+    input_queue_init(input);
+    input_queue_init(consumed);
+    int move_dir = 0;
+
+    SimThread sim;
+    sim_thread_start(sim, &world, &snapshots, &input, &consumed, NULL, NULL);
+
+    FrameStats render_stats = {};
+    uint64_t last_tick = 0;
+    for(;;)
+    {
+        uint64_t frame_start = monotonic_time_ns();
+        const GameSnapshot* snapshot = triple_buffer_acquire(snapshots);
+        if(!snapshot) continue;
+        if(snapshot->game.tick >= num_ticks) break;
+
+        if(snapshot->game.tick != last_tick)
+        {
+            last_tick = snapshot->game.tick;
+            Input scripted = scripted_input(last_tick);
+            uint64_t now_ns = monotonic_time_ns();
+            push_move(input, move_dir, scripted.move_dir, now_ns);
+            move_dir = scripted.move_dir;
+            if(scripted.fire_pressed) input_queue_push(input, {now_ns, 0, INPUT_FIRE});
+        }
+
+        double alpha = (double)(monotonic_time_ns() - snapshot->publish_time_ns) / SIM_TICK_NS;
+        world_draw_snapshot(world, *snapshot, std::min(alpha, 1.0));
+
+        uint64_t frame_end = monotonic_time_ns();
+        input_latency_record(consumed, snapshot->game.tick, frame_end);
+        frame_stats_add(render_stats, frame_end - frame_start);
+    }
+
+    sim_thread_stop(sim);
+    frame_stats_print(sim.tick_stats, "Simulation tick");
+    frame_stats_print(render_stats, "Render frame");
+    printf("Input events dropped: %u\n", input.dropped + consumed.dropped);
+    triple_buffer_destroy(snapshots);
+}
+
+// Scripted input, offset per env so the sessions diverge
+static Input env_scripted_policy(void*, size_t env, const World& world)
+{
+    return scripted_input(world.game.tick + env * 37);
+}
+
+// Hash of every env's simulation state, to check runs on different thread
+// counts agree
+static uint64_t env_runner_checksum(const EnvRunner& runner)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t env = 0; env < runner.num_envs; ++env)
+    {
+        hash = (hash ^ world_checksum(runner.worlds[env])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Aggregate ticks per second of num_envs independent sessions as the
+// thread count doubles up to max_threads (0 for the hardware's), both
+// free-running and in lockstep, checked against the single-threaded result
+int run_env_bench(size_t num_envs, size_t num_ticks, size_t max_threads, bool render)
+{
+    if(!max_threads) max_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    Input* inputs = new Input[num_envs];
+    uint64_t reference = 0;
+    double base_steps_per_s = 0.0;
+    bool all_match = true;
+
+    printf("threads,envs,steps_per_s,lockstep_steps_per_s,speedup,match\n");
+    for(size_t num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+    {
+        EnvRunner runner;
+        if(!env_runner_init(runner, num_envs, num_threads, render))
+        {
+            fprintf(stderr, "Error: could not build %zu envs\n", num_envs);
+            delete[] inputs;
+            return 1;
+        }
+
+        bench_clock::time_point start = bench_clock::now();
+        env_runner_run(runner, num_ticks, env_scripted_policy, NULL);
+        double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        uint64_t checksum = env_runner_checksum(runner);
+
+        bool reset = true;
+        for(size_t env = 0; env < num_envs; ++env) reset &= env_runner_reset(runner, env);
+        start = bench_clock::now();
+        for(size_t tick = 0; tick < num_ticks; ++tick)
+        {
+            for(size_t env = 0; env < num_envs; ++env)
+            {
+                inputs[env] = env_scripted_policy(NULL, env, runner.worlds[env]);
+            }
+            env_runner_step(runner, inputs);
+        }
+        double lockstep_elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        bool match = reset && env_runner_checksum(runner) == checksum;
+
+        if(num_threads == 1) reference = checksum;
+        match = match && checksum == reference;
+        all_match = all_match && match;
+
+        double steps_per_s = elapsed > 0.0 ? num_envs * num_ticks / elapsed : 0.0;
+        double lockstep_steps_per_s = lockstep_elapsed > 0.0 ? num_envs * num_ticks / lockstep_elapsed : 0.0;
+        if(num_threads == 1) base_steps_per_s = steps_per_s;
+        printf(
+            "%zu,%zu,%.0f,%.0f,%.2f,%d\n",
+            thread_pool_size(runner.pool), num_envs, steps_per_s, lockstep_steps_per_s,
+            base_steps_per_s > 0.0 ? steps_per_s / base_steps_per_s : 0.0, match
+        );
+        if(!match) fprintf(stderr, "Env results differ with %zu threads\n", num_threads);
+
+        env_runner_destroy(runner);
+        if(num_threads == max_threads) break;
+    }
+
+    delete[] inputs;
+    return all_match ? 0 : 1;
+}
+
+// Feeds a recorded session back through the simulation as fast as possible
+// and checks the result against the checksum stored with the recording
+int run_replay(World& world, const char* path)
+{
+    InputRecording recording;
+    if(!input_recording_load(recording, path)) return -1;
+    if(!game_config_equal(recording.config, world.config))
+    {
+        fprintf(stderr, "Error: %s was recorded with a different game config\n", path);
+        input_recording_destroy(recording);
+        return -1;
+    }
+
+    InputPlayback playback;
+    input_playback_init(playback, recording);
+
+    bench_clock::time_point start = bench_clock::now();
+    Input input;
+    while(input_playback_next(playback, input))
+    {
+        world_tick(world, input);
+    }
+    double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    uint64_t checksum = world_checksum(world);
+    bool match = checksum == recording.final_checksum;
+
+    printf("ticks: %zu\n", recording.num_ticks);
+    printf("input_runs: %zu\n", recording.num_runs);
+    printf("elapsed_s: %.6f\n", elapsed);
+    printf("ticks_per_s: %.1f\n", elapsed > 0.0 ? recording.num_ticks / elapsed : 0.0);
+    printf("sim_checksum: %016llx\n", (unsigned long long)checksum);
+    printf("expected_checksum: %016llx\n", (unsigned long long)recording.final_checksum);
+    printf("match: %d\n", match);
+
+    input_recording_destroy(recording);
+    return match ? 0 : 1;
+}
+
+// Plays a level, restarts it in place and plays it again. The second run
+// must match the first bit for bit and the restarts must not touch the heap.
+int run_restart_bench(World& world, size_t num_ticks)
+{
+    const size_t num_restarts = 1000;
+
+    for(size_t tick = 0; tick < num_ticks; ++tick) world_tick(world, scripted_input(tick));
+    uint64_t first_checksum = world_checksum(world);
+
+    size_t allocations = heap_allocations.load(std::memory_order_relaxed);
+    bench_clock::time_point start = bench_clock::now();
+    bool restarted = true;
+    for(size_t i = 0; i < num_restarts; ++i) restarted &= world_restart(world);
+    double restart_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num_restarts;
+    allocations = heap_allocations.load(std::memory_order_relaxed) - allocations;
+
+    for(size_t tick = 0; tick < num_ticks; ++tick) world_tick(world, scripted_input(tick));
+    uint64_t second_checksum = world_checksum(world);
+    bool match = first_checksum == second_checksum;
+
+    printf("ticks: %zu\n", num_ticks);
+    printf("restarts: %zu\n", num_restarts);
+    printf("ns_per_restart: %.1f\n", restart_ns);
+    printf("restart_heap_allocations: %zu\n", allocations);
+    printf("arena_bytes: %zu\n", world.arena.capacity);
+    printf("arena_high_water: %zu\n", world.arena.high_water);
+    printf("sim_checksum: %016llx\n", (unsigned long long)second_checksum);
+    printf("match: %d\n", match);
+
+    return restarted && match && allocations == 0 ? 0 : 1;
+}
+
+// Kills part of the formation through handles and times ticks and draw
+// list builds with what is left, which should scale with the live count.
+// Handles of the killed aliens must stop resolving once their death
+// sprites are gone, and the rest must keep naming the same slot.
+int run_wave_bench(World& world, size_t num_ticks)
+{
+    const size_t alive_tenths[] = {10, 5, 1, 0};
+    AlienHandle handles[NUM_OF_ALIENS];
+    bool all_ok = true;
+
+    printf("alive,ns_per_tick,handles_ok\n");
+    for(size_t alive : alive_tenths)
+    {
+        if(!world_restart(world)) return 1;
+        AlienStore& aliens = world.game.aliens;
+        for(size_t slot = 0; slot < aliens.count; ++slot)
+        {
+            handles[slot] = alien_handle(aliens, (uint32_t)slot);
+            if(slot % 10 >= alive) world_kill_alien(world, handles[slot]);
+        }
+
+        // Long enough for every death sprite to run out
+        Input idle = {0, false};
+        for(size_t tick = 0; tick < 32; ++tick) world_tick(world, idle);
+
+        bool handles_ok = aliens.num_shown == aliens.num_live;
+        for(size_t slot = 0; slot < aliens.count; ++slot)
+        {
+            size_t ai;
+            bool resolved = alien_resolve(aliens, handles[slot], ai);
+            if(slot % 10 >= alive) handles_ok &= !resolved;
+            else handles_ok &= resolved && aliens.slot[ai] == slot && ai < aliens.num_live;
+        }
+
+        bench_clock::time_point start = bench_clock::now();
+        for(size_t tick = 0; tick < num_ticks; ++tick)
+        {
+            world_tick(world, {scripted_input(tick).move_dir, false});
+            world_build_draw_list(world, 1.0);
+        }
+        double tick_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num_ticks;
+
+        printf("%zu,%.1f,%d\n", aliens.num_live, tick_ns, handles_ok);
+        all_ok &= handles_ok;
+    }
+
+    return all_ok ? 0 : 1;
+}
+
+static uint64_t elapsed_ns(bench_clock::time_point& start)
+{
+    bench_clock::time_point now = bench_clock::now();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    start = now;
+    return ns;
+}
+
+// The game scaled far past its real sizes. Every tick the bullet pool is
+// topped back up to its cap with bullets at random spots, half of them
+// going each way, so bullet work stays at the cap while the formation is
+// worn down. Each phase of the tick and the frame is timed on its own.
+int run_stress_bench(const GameConfig& config, size_t num_ticks, bool full_redraw)
+{
+    World world = {};
+    if(!world_init(world, true, config))
+    {
+        fprintf(stderr, "Error: could not build a %zux%zu world\n", config.width, config.height);
+        return 1;
+    }
+    if(full_redraw) world.dirty.enabled = false;
+
+    Game& game = world.game;
+    BulletStore& bullets = game.bullets;
+    const size_t num_aliens = game.aliens.count;
+
+    enum { SPAWN, MOVE_ALIENS, ANIMATIONS, ALIEN_SIM, BULLET_SIM, PLAYER, DRAW_LIST, RENDER, NUM_PHASES };
+    static const char* phase_names[NUM_PHASES] = {
+        "bullet_spawn", "alien_move", "animations", "alien_sim",
+        "bullet_sim", "player", "build_draw_list", "render"
+    };
+    FrameStats phases[NUM_PHASES] = {};
+    FrameStats frames = {};
+    size_t bullets_simulated = 0;
+
+    uint32_t seed = 1;
+    for(size_t tick = 0; tick < num_ticks; ++tick)
+    {
+        bench_clock::time_point frame_start = bench_clock::now();
+        bench_clock::time_point start = frame_start;
+
+        stress_refill_bullets(world, seed);
+        bullets_simulated += bullets.count;
+        frame_stats_add(phases[SPAWN], elapsed_ns(start));
+
+        // world_tick, a phase at a time
+        Input input = scripted_input(tick);
+        world.prev_player_x = game.player.x;
+        world_move_aliens(world);
+        frame_stats_add(phases[MOVE_ALIENS], elapsed_ns(start));
+        world_update_animations(world);
+        frame_stats_add(phases[ANIMATIONS], elapsed_ns(start));
+        world_simulate_aliens(world);
+        frame_stats_add(phases[ALIEN_SIM], elapsed_ns(start));
+        world_simulate_bullets(world);
+        frame_stats_add(phases[BULLET_SIM], elapsed_ns(start));
+        simulate_player(game, *world.atlas, input.move_dir);
+        process_events(game, *world.atlas, input.fire_pressed);
+        ++game.tick;
+        frame_stats_add(phases[PLAYER], elapsed_ns(start));
+
+        world_build_draw_list(world, 1.0);
+        frame_stats_add(phases[DRAW_LIST], elapsed_ns(start));
+        world_render(world);
+        frame_stats_add(phases[RENDER], elapsed_ns(start));
+
+        frame_stats_add(frames, elapsed_ns(frame_start));
+    }
+
+    printf("buffer: %zux%zu\n", config.width, config.height);
+    printf("aliens: %zu (%zux%zu)\n", num_aliens, config.alien_rows, config.alien_cols);
+    printf("aliens_left: %zu\n", game.aliens.num_live);
+    printf("max_bullets: %zu\n", config.max_bullets);
+    printf("bullets_per_tick: %.0f\n", num_ticks ? (double)bullets_simulated / num_ticks : 0.0);
+    printf("arena_bytes: %zu\n", world.arena.capacity);
+    for(size_t i = 0; i < NUM_PHASES; ++i) frame_stats_print(phases[i], phase_names[i]);
+    frame_stats_print(frames, "frame");
+    printf("sim_checksum: %016llx\n", (unsigned long long)world_checksum(world));
+
+    world_destroy(world);
+    return 0;
+}
+
+static bool input_equal(const Input& a, const Input& b)
+{
+    return a.move_dir == b.move_dir && a.fire_pressed == b.fire_pressed;
+}
+
+// Rollback in miniature: each tick's input arrives delay ticks late, so the
+// tick runs on a prediction, the last input that did arrive. When the real
+// input turns out different, the world rewinds to that tick and simulates
+// forward again. The end state must match a run that had every input on
+// time, the history must rewind to its oldest state intact, and none of it
+// may touch the heap.
+int run_rollback_bench(World& world, size_t num_ticks, size_t delay)
+{
+    const size_t history_ticks = 10 * SIM_TICKS_PER_SECOND;
+
+    if(!world_restart(world)) return 1;
+    uint64_t* reference = new uint64_t[num_ticks + 1];
+    reference[0] = world_checksum(world);
+    for(size_t tick = 0; tick < num_ticks; ++tick)
+    {
+        world_tick(world, scripted_input(tick));
+        reference[tick + 1] = world_checksum(world);
+    }
+
+    SnapshotRing ring;
+    snapshot_ring_init(ring, world.game.aliens.count, world.game.bullets.max_count, history_ticks, 0);
+    Input* predicted = new Input[num_ticks];
+
+    bool restarted = world_restart(world);
+    snapshot_ring_push(ring, world);
+
+    size_t num_pushes = 0, num_rollbacks = 0, num_resimulated = 0;
+    double push_ns = 0.0, rewind_ns = 0.0;
+    bool rewind_failed = false;
+    auto push = [&]()
+    {
+        bench_clock::time_point start = bench_clock::now();
+        snapshot_ring_push(ring, world);
+        push_ns += std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+        ++num_pushes;
+    };
+
+    size_t allocations = heap_allocations.load(std::memory_order_relaxed);
+    bench_clock::time_point start = bench_clock::now();
+
+    // Runs delay ticks past the end so the last inputs are confirmed too
+    Input confirmed = {};
+    for(size_t tick = 0; tick < num_ticks + delay; ++tick)
+    {
+        size_t present = std::min(tick, num_ticks);
+        if(tick >= delay)
+        {
+            size_t late = tick - delay;
+            confirmed = scripted_input(late);
+            if(!input_equal(confirmed, predicted[late]))
+            {
+                bench_clock::time_point rewind_start = bench_clock::now();
+                rewind_failed |= !snapshot_ring_rewind(ring, late, world);
+                rewind_ns += std::chrono::duration<double, std::nano>(bench_clock::now() - rewind_start).count();
+                ++num_rollbacks;
+
+                predicted[late] = confirmed;
+                for(size_t t = late; t < present; ++t)
+                {
+                    if(t > late) predicted[t] = confirmed;
+                    world_tick(world, predicted[t]);
+                    push();
+                    ++num_resimulated;
+                }
+            }
+        }
+
+        if(tick < num_ticks)
+        {
+            predicted[tick] = confirmed;
+            world_tick(world, predicted[tick]);
+            push();
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+    allocations = heap_allocations.load(std::memory_order_relaxed) - allocations;
+
+    uint64_t checksum = world_checksum(world);
+    bool match = restarted && !rewind_failed && checksum == reference[num_ticks];
+
+    size_t delta_bytes = 0;
+    for(size_t i = 0; i < ring.num_deltas; ++i)
+    {
+        delta_bytes += ring.deltas[(ring.first_delta + i) % ring.max_deltas].size;
+    }
+    size_t num_deltas = ring.num_deltas;
+
+    uint64_t oldest = snapshot_ring_oldest_tick(ring);
+    bool rewind_match =
+        snapshot_ring_rewind(ring, oldest, world) &&
+        world_checksum(world) == reference[oldest];
+
+    printf("ticks: %zu\n", num_ticks);
+    printf("input_delay: %zu\n", delay);
+    printf("rollbacks: %zu\n", num_rollbacks);
+    printf("resimulated_ticks: %zu\n", num_resimulated);
+    printf("elapsed_s: %.6f\n", elapsed);
+    printf("state_bytes: %zu\n", ring.state_size);
+    printf("mean_delta_bytes: %.1f\n", num_deltas ? (double)delta_bytes / num_deltas : 0.0);
+    printf("history_ticks: %zu\n", num_deltas);
+    printf("ns_per_snapshot: %.1f\n", num_pushes ? push_ns / num_pushes : 0.0);
+    printf("ns_per_rewind: %.1f\n", num_rollbacks ? rewind_ns / num_rollbacks : 0.0);
+    printf("rollback_heap_allocations: %zu\n", allocations);
+    printf("sim_checksum: %016llx\n", (unsigned long long)checksum);
+    printf("match: %d\n", match);
+    printf("rewind_to_tick: %llu\n", (unsigned long long)oldest);
+    printf("rewind_match: %d\n", rewind_match);
+
+    snapshot_ring_destroy(ring);
+    delete[] predicted;
+    delete[] reference;
+    return match && rewind_match && allocations == 0 ? 0 : 1;
+}
+
+// Replays the scripted session and compares every frame of a captured
+// stream with a fresh render of the same tick, as a golden-image check
+int run_capture_verify(World& world, const char* path)
+{
+    FrameStreamReader reader;
+    if(!frame_stream_open(reader, path)) return -1;
+
+    size_t num_frames = 0, num_mismatches = 0;
+    bool ok = reader.frame.width == world.buffer.width && reader.frame.height == world.buffer.height;
+    while(ok && frame_stream_next(reader))
+    {
+        if(reader.tick < world.game.tick)
+        {
+            ok = false;
+            break;
+        }
+        while(world.game.tick < reader.tick) world_tick(world, scripted_input(world.game.tick));
+
+        world_draw(world, 1.0);
+        if(buffer_checksum(reader.frame) != frame_checksum(world))
+        {
+            if(!num_mismatches) fprintf(stderr, "First mismatch at frame %llu, tick %llu\n", (unsigned long long)reader.frame_number, (unsigned long long)reader.tick);
+            ++num_mismatches;
+        }
+        ++num_frames;
+    }
+    frame_stream_close(reader);
+
+    printf("frames: %zu\n", num_frames);
+    printf("mismatches: %zu\n", num_mismatches);
+    printf("match: %d\n", ok && num_frames && !num_mismatches);
+    return ok && num_frames && !num_mismatches ? 0 : 1;
+}
+
+// Runs the simulation with scripted input, timing each phase of the tick.
+// Returns non-zero if the recording could not be saved.
+int run_tick_bench(World& world, size_t num_ticks, size_t render_every, const char* record_path, FrameCapture* capture)
+{
+    InputRecording recording;
+    input_recording_init(recording, world.config);
+
+    uint64_t phase_ns[NUM_PHASES] = {};
+    bench_clock::time_point start = bench_clock::now();
+
+    for(size_t tick = 0; tick < num_ticks; ++tick)
+    {
+        Input input = scripted_input(tick);
+        bench_clock::time_point t[NUM_PHASES + 1];
+        if(record_path) input_recording_push(recording, input);
+
+        // Same order as world_tick(), timed phase by phase
+        world.prev_player_x = world.game.player.x;
+        t[0] = bench_clock::now();
+        world_move_aliens(world);
+        t[1] = bench_clock::now();
+        world_update_animations(world);
+        t[2] = bench_clock::now();
+        world_simulate_aliens(world);
+        t[3] = bench_clock::now();
+        world_simulate_bullets(world);
+        t[4] = bench_clock::now();
+        simulate_player(world.game, *world.atlas, input.move_dir);
+        t[5] = bench_clock::now();
+        process_events(world.game, *world.atlas, input.fire_pressed);
+        ++world.game.tick;
+        t[6] = bench_clock::now();
+        if(render_every && (tick + 1) % render_every == 0)
+        {
+            world_draw(world, 1.0);
+            if(capture && world.indexed)
+            {
+                frame_capture_push(*capture, world.indexed_buffer, world.palette, world.game.tick);
+            }
+            else if(capture)
+            {
+                frame_capture_push(*capture, world.buffer, world.game.tick);
+            }
+        }
+        t[7] = bench_clock::now();
+
+        for(size_t p = 0; p < NUM_PHASES; ++p)
+        {
+            phase_ns[p] += std::chrono::duration_cast<std::chrono::nanoseconds>(t[p + 1] - t[p]).count();
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    printf("ticks: %zu\n", num_ticks);
+    printf("elapsed_s: %.6f\n", elapsed);
+    printf("ticks_per_s: %.1f\n", elapsed > 0.0 ? num_ticks / elapsed : 0.0);
+    for(size_t p = 0; p < NUM_PHASES; ++p)
+    {
+        printf("ns_per_tick.%s: %.1f\n", phase_names[p], num_ticks ? (double)phase_ns[p] / num_ticks : 0.0);
+    }
+    printf("sim_checksum: %016llx\n", (unsigned long long)world_checksum(world));
+    printf("checksum: %016llx\n", (unsigned long long)frame_checksum(world));
+
+    bool saved = true;
+    if(record_path)
+    {
+        recording.final_checksum = world_checksum(world);
+        saved = input_recording_save(recording, record_path);
+    }
+    input_recording_destroy(recording);
+    return saved ? 0 : 1;
+}
+
+void print_usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s --headless [--ticks N] [--render-every N] [--collision] [--bands] [--pipeline] [--restart] [--wave] [--stress [--width N] [--height N] [--rows N] [--cols N] [--bullets N]] [--rollback DELAY] [--dirty] [--full-redraw] [--indexed] [--envs N] [--env-threads N] [--env-render] [--render-threads N] [--record PATH] [--replay PATH] [--capture PATH] [--capture-every N] [--verify-capture PATH] [--profile] [--trace PATH]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    bool headless = false;
+    size_t num_ticks = 10000;
+    size_t render_every = 1;
+    bool collision = false;
+    bool bands = false;
+    bool pipeline = false;
+    bool restart = false;
+    bool wave = false;
+    bool stress = false;
+    bool ticks_given = false;
+    GameConfig stress_config = {3840, 2160, 100, 100, 100000};
+    size_t rollback_delay = 0;
+    bool dirty = false;
+    bool full_redraw = false;
+    bool indexed = false;
+    size_t num_envs = 0;
+    bool env_render = false;
+    size_t env_threads = 0;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    const char* capture_path = NULL;
+    size_t capture_every = 1;
+    const char* verify_capture_path = NULL;
+    bool profile = false;
+    const char* trace_path = NULL;
+    size_t render_threads = 0;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+        else if(strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            num_ticks = strtoul(argv[++i], NULL, 10);
+            ticks_given = true;
+        }
+        else if(strcmp(argv[i], "--collision") == 0)
+        {
+            collision = true;
+        }
+        else if(strcmp(argv[i], "--bands") == 0)
+        {
+            bands = true;
+        }
+        else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            record_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replay_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            capture_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--capture-every") == 0 && i + 1 < argc)
+        {
+            capture_every = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--verify-capture") == 0 && i + 1 < argc)
+        {
+            verify_capture_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--profile") == 0)
+        {
+            profile = true;
+        }
+        else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipeline = true;
+        }
+        else if(strcmp(argv[i], "--restart") == 0)
+        {
+            restart = true;
+        }
+        else if(strcmp(argv[i], "--wave") == 0)
+        {
+            wave = true;
+        }
+        else if(strcmp(argv[i], "--stress") == 0)
+        {
+            stress = true;
+        }
+        else if(strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+        {
+            stress_config.width = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+        {
+            stress_config.height = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+        {
+            stress_config.alien_rows = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--cols") == 0 && i + 1 < argc)
+        {
+            stress_config.alien_cols = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--bullets") == 0 && i + 1 < argc)
+        {
+            stress_config.max_bullets = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--rollback") == 0 && i + 1 < argc)
+        {
+            rollback_delay = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--dirty") == 0)
+        {
+            dirty = true;
+        }
+        else if(strcmp(argv[i], "--full-redraw") == 0)
+        {
+            full_redraw = true;
+        }
+        else if(strcmp(argv[i], "--indexed") == 0)
+        {
+            indexed = true;
+        }
+        else if(strcmp(argv[i], "--envs") == 0 && i + 1 < argc)
+        {
+            num_envs = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--env-render") == 0)
+        {
+            env_render = true;
+        }
+        else if(strcmp(argv[i], "--env-threads") == 0 && i + 1 < argc)
+        {
+            env_threads = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--render-threads") == 0 && i + 1 < argc)
+        {
+            render_threads = strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--render-every") == 0 && i + 1 < argc)
+        {
+            render_every = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if(stress && !game_config_valid(stress_config))
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if(!headless)
+    {
+        // Only the headless loop exists here; the windowed game is ./main
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if(num_envs)
+    {
+        return run_env_bench(num_envs, num_ticks, env_threads, env_render);
+    }
+
+    if(stress && dirty)
+    {
+        World world = {};
+        if(!world_init(world, true, stress_config)) return -1;
+        int result = run_dirty_bench(world, ticks_given ? num_ticks : 300, true);
+        world_destroy(world);
+        return result;
+    }
+
+    if(stress)
+    {
+        return run_stress_bench(stress_config, ticks_given ? num_ticks : 300, full_redraw);
+    }
+
+    World world = {};
+    if(!world_init(world))
+    {
+        fprintf(stderr, "Error: could not build the world\n");
+        return -1;
+    }
+    if(full_redraw) world.dirty.enabled = false;
+
+    if(replay_path)
+    {
+        int result = run_replay(world, replay_path);
+        world_destroy(world);
+        return result;
+    }
+
+    if(verify_capture_path)
+    {
+        int result = run_capture_verify(world, verify_capture_path);
+        world_destroy(world);
+        return result;
+    }
+
+    if(restart)
+    {
+        int result = run_restart_bench(world, num_ticks);
+        world_destroy(world);
+        return result;
+    }
+
+    if(wave)
+    {
+        int result = run_wave_bench(world, num_ticks);
+        world_destroy(world);
+        return result;
+    }
+
+    if(rollback_delay)
+    {
+        int result = run_rollback_bench(world, num_ticks, rollback_delay);
+        world_destroy(world);
+        return result;
+    }
+
+    if(collision)
+    {
+        run_collision_bench(*world.atlas);
+        world_destroy(world);
+        return 0;
+    }
+
+    if(bands)
+    {
+        // Render a mid-game frame with bullets in flight
+        for(size_t tick = 0; tick < 600; ++tick) world_tick(world, scripted_input(tick));
+        run_band_bench(world, render_threads);
+        world_destroy(world);
+        return 0;
+    }
+
+    if(indexed) world_set_indexed(world, true);
+
+    if(dirty)
+    {
+        int result = run_dirty_bench(world, num_ticks, false);
+        world_destroy(world);
+        return result;
+    }
+
+    BandRenderer band_renderer;
+    if(render_threads > 1)
+    {
+        band_renderer_init(band_renderer, render_threads, 0);
+        world.band_renderer = &band_renderer;
+    }
+
+    int result = 0;
+    if(pipeline)
+    {
+        run_pipeline_bench(world, num_ticks);
+    }
+    else
+    {
+        FrameCapture capture;
+        bool capturing = false;
+        if(capture_path)
+        {
+            size_t length = strlen(capture_path);
+            CaptureFormat format = length >= 4 && strcmp(capture_path + length - 4, ".png") == 0
+                ? CAPTURE_FORMAT_PNG : CAPTURE_FORMAT_STREAM;
+            capturing = frame_capture_start(
+                capture, world.buffer.width, world.buffer.height,
+                format, capture_path, capture_every, 8
+            );
+            if(!capturing) return -1;
+        }
+
+        result = run_tick_bench(world, num_ticks, render_every, record_path, capturing ? &capture : NULL);
+
+        if(capturing)
+        {
+            bench_clock::time_point start = bench_clock::now();
+            if(!frame_capture_stop(capture)) result = 1;
+            double drain_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+            frame_capture_print_stats(capture, stdout);
+            printf("capture_written: %llu\n", (unsigned long long)capture.written);
+            printf("capture_failed: %d\n", capture.failed);
+            printf("capture_drain_s: %.6f\n", drain_s);
+        }
+    }
+
+    if(profile) profiler_print_summary(stdout);
+    if(trace_path) profiler_write_chrome_trace(trace_path);
+
+    if(world.band_renderer) band_renderer_destroy(band_renderer);
+    world_destroy(world);
+
+    return result;
+}
@@ -0,0 +1,93 @@
+#include "bunkers.h"
+
+void bunkers_init(BunkerField& bunkers, const PackedSprite& shape, size_t count, int16_t x, int16_t y, int16_t spacing)
+{
+    bunkers.count = count < GAME_MAX_BUNKERS ? count : GAME_MAX_BUNKERS;
+    bunkers.x = x;
+    bunkers.y = y;
+    bunkers.spacing = spacing;
+    for(size_t i = 0; i < bunkers.count; ++i)
+    {
+        bunkers.revision[i] = 0;
+        bunkers.masks[i] = shape;
+    }
+}
+
+void bunker_carve(BunkerField& bunkers, size_t bunker, int x, int y, const PackedSprite& stamp)
+{
+    PackedSprite& mask = bunkers.masks[bunker];
+    int local_x = x - (bunkers.x + (int)bunker * bunkers.spacing);
+    int local_y = y - bunkers.y;
+    if(local_x <= -(int)stamp.width || local_x >= (int)mask.width) return;
+
+    int row_begin = local_y > 0 ? local_y : 0;
+    int row_end = local_y + (int)stamp.height;
+    if(row_end > (int)mask.height) row_end = mask.height;
+
+    // Bits shifted past the mask's width only clear pixels that are not there
+    for(int row = row_begin; row < row_end; ++row)
+    {
+        uint64_t bits = stamp.rows[row - local_y];
+        mask.rows[row] &= ~(local_x >= 0 ? bits << local_x : bits >> -local_x);
+    }
+    ++bunkers.revision[bunker];
+}
+
+size_t bunkers_resolve_bullets(
+    BunkerField& bunkers, BulletStore& bullets,
+    const PackedSprite& bullet, const PackedSprite& stamp, uint32_t* scratch
+)
+{
+    if(!bunkers.count) return 0;
+
+    // Every bunker has the same height, so one band test rejects most
+    // bullets; gather the rest without branching
+    const int band_bottom = bunkers.y;
+    const int band_top = bunkers.y + (int)bunkers.masks[0].height;
+    const int bullet_height = bullet.height;
+    uint32_t* candidates = scratch;
+    size_t num_candidates = 0;
+    for(size_t bi = 0; bi < bullets.count; ++bi)
+    {
+        candidates[num_candidates] = (uint32_t)bi;
+        num_candidates += bullets.y[bi] + bullet_height > band_bottom && bullets.y[bi] < band_top;
+    }
+
+    // Hits are written over the candidates already read
+    uint32_t* hits = scratch;
+    size_t num_hits = 0;
+    const int last_bunker = (int)bunkers.count - 1;
+    for(size_t i = 0; i < num_candidates; ++i)
+    {
+        size_t bi = candidates[i];
+        int x = bullets.x[bi], y = bullets.y[bi];
+
+        // Bunkers whose slot the bullet's left and right edges fall in
+        int left = x - bunkers.x;
+        int right = left + (int)bullet.width - 1;
+        if(right < 0) continue;
+        int first = left < 0 ? 0 : left / bunkers.spacing;
+        int last = right / bunkers.spacing;
+        if(last > last_bunker) last = last_bunker;
+
+        for(int bunker = first; bunker <= last; ++bunker)
+        {
+            int bunker_x = bunkers.x + bunker * bunkers.spacing;
+            if(!sprite_overlap_check(bullet, x, y, bunkers.masks[bunker], bunker_x, bunkers.y)) continue;
+
+            int impact_y = bullets.dir[bi] > 0 ? y + bullet_height : y;
+            bunker_carve(
+                bunkers, bunker,
+                x + (int)bullet.width / 2 - (int)stamp.width / 2,
+                impact_y - (int)stamp.height / 2, stamp
+            );
+            hits[num_hits++] = (uint32_t)bi;
+            break;
+        }
+    }
+
+    // Hits are in ascending order; removing from the back means every swap
+    // pulls in a bullet that is not itself waiting to be removed
+    for(size_t i = num_hits; i-- > 0;) bullets_remove(bullets, hits[i]);
+    return num_hits;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "entities.h"
+#include "sprite.h"
+
+constexpr int GAME_MAX_BUNKERS = 4;
+
+// Shields between the player and the aliens, each a packed bitmap that
+// bullets wear away. They sit in one row at a fixed spacing, so a bullet
+// finds the bunker under it with a divide instead of a search.
+struct BunkerField
+{
+    size_t count;
+    // Bottom-left corner of the first bunker, and the distance between the
+    // left edges of neighbours
+    int16_t x, y;
+    int16_t spacing;
+    // Bumped whenever a mask changes, so the renderer can tell new pixels
+    // from old without comparing them
+    uint32_t revision[GAME_MAX_BUNKERS];
+    // Bounds stay those of the intact shape, so they cover anything a
+    // bunker has drawn since
+    PackedSprite masks[GAME_MAX_BUNKERS];
+};
+
+// Lays out count copies of shape; spacing must leave a gap of at least a
+// bullet's width between bunkers
+void bunkers_init(BunkerField& bunkers, const PackedSprite& shape, size_t count, int16_t x, int16_t y, int16_t spacing);
+
+// Clears stamp's set pixels out of one bunker, with stamp's bottom-left
+// corner at a playfield position
+void bunker_carve(BunkerField& bunkers, size_t bunker, int x, int y, const PackedSprite& stamp);
+
+// Resolves every bullet against the bunkers in one pass. Bullets outside
+// the rows the bunkers share are rejected with a compare; the rest are
+// tested against the one or two bunkers they can reach, by row mask. A hit
+// carves stamp around the bullet's leading end and removes the bullet, in
+// bullet order, so later bullets see earlier carving. scratch must hold
+// bullets.count entries. Returns the hits.
+size_t bunkers_resolve_bullets(
+    BunkerField& bunkers, BulletStore& bullets,
+    const PackedSprite& bullet, const PackedSprite& stamp, uint32_t* scratch
+);
@@ -0,0 +1,415 @@
+#include "capture.h"
+#include "profiler.h"
+#include "replay.h"
+
+#include <chrono>
+#include <cstring>
+
+#if CAPTURE_PNG
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#endif
+
+static const char STREAM_MAGIC[4] = {'S', 'I', 'F', 'S'};
+static const uint8_t STREAM_VERSION = 1;
+
+// The writer wakes on its own this often, in case a notify raced with it
+// going to sleep; the render thread never takes the mutex
+constexpr auto CAPTURE_WRITER_POLL = std::chrono::milliseconds(2);
+
+// True if pattern has exactly one conversion and it takes an unsigned
+// long long, optionally with flags and a width, e.g. "%06llu"; "%%" is
+// allowed anywhere. Anything else would hand snprintf the wrong arguments,
+// or write every frame to the same file.
+static bool png_pattern_valid(const char* pattern)
+{
+    size_t conversions = 0;
+    for(const char* c = pattern; *c; ++c)
+    {
+        if(*c != '%') continue;
+        if(*++c == '%') continue;
+
+        while(*c && strchr("-+ #0", *c)) ++c;
+        while(*c >= '0' && *c <= '9') ++c;
+        if(strncmp(c, "llu", 3) != 0) return false;
+        c += 2;
+        ++conversions;
+    }
+    return conversions == 1;
+}
+
+// Buffer pixels are 0xRRGGBBAA words with the bottom row first; PNG wants
+// RGBA bytes with the top row first
+static bool write_png(FrameCapture& capture, const CaptureSlot& slot)
+{
+#if CAPTURE_PNG
+    size_t width = capture.width, height = capture.height;
+    for(size_t y = 0; y < height; ++y)
+    {
+        const uint32_t* src = slot.pixels + (height - 1 - y) * width;
+        uint8_t* dst = capture.rgba + y * width * 4;
+        for(size_t x = 0; x < width; ++x)
+        {
+            dst[4 * x + 0] = (uint8_t)(src[x] >> 24);
+            dst[4 * x + 1] = (uint8_t)(src[x] >> 16);
+            dst[4 * x + 2] = (uint8_t)(src[x] >> 8);
+            dst[4 * x + 3] = (uint8_t)src[x];
+        }
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), capture.path, (unsigned long long)slot.frame);
+    if(!stbi_write_png(path, (int)width, (int)height, 4, capture.rgba, (int)(width * 4)))
+    {
+        fprintf(stderr, "Error writing %s.\n", path);
+        return false;
+    }
+    return true;
+#else
+    (void)capture;
+    (void)slot;
+    return false;
+#endif
+}
+
+// Calls emit(skip, begin, length) for every run of pixels that differ
+// between frame and prev, and returns the number of runs
+template <typename Emit>
+static size_t for_each_changed_run(const uint32_t* frame, const uint32_t* prev, size_t count, Emit emit)
+{
+    size_t num_runs = 0;
+    size_t last_end = 0;
+    size_t i = 0;
+    while(i < count)
+    {
+        if(frame[i] == prev[i])
+        {
+            ++i;
+            continue;
+        }
+
+        size_t begin = i;
+        while(i < count && frame[i] != prev[i]) ++i;
+        emit(begin - last_end, begin, i - begin);
+        last_end = i;
+        ++num_runs;
+    }
+    return num_runs;
+}
+
+// Pixels go out little-endian whatever the host order
+static void write_pixels(FILE* file, const uint32_t* pixels, size_t count)
+{
+    uint8_t bytes[4 * 256];
+    while(count)
+    {
+        size_t chunk = count < 256 ? count : 256;
+        for(size_t i = 0; i < chunk; ++i)
+        {
+            bytes[4 * i + 0] = (uint8_t)pixels[i];
+            bytes[4 * i + 1] = (uint8_t)(pixels[i] >> 8);
+            bytes[4 * i + 2] = (uint8_t)(pixels[i] >> 16);
+            bytes[4 * i + 3] = (uint8_t)(pixels[i] >> 24);
+        }
+        fwrite(bytes, 4, chunk, file);
+        pixels += chunk;
+        count -= chunk;
+    }
+}
+
+static bool read_pixels(FILE* file, uint32_t* pixels, size_t count)
+{
+    if(fread(pixels, sizeof(uint32_t), count, file) != count) return false;
+    for(size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* bytes = (const uint8_t*)(pixels + i);
+        pixels[i] = bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    }
+    return true;
+}
+
+static bool write_stream_frame(FrameCapture& capture, const CaptureSlot& slot)
+{
+    FILE* file = capture.stream;
+    size_t count = capture.width * capture.height;
+
+    size_t num_runs = for_each_changed_run(slot.pixels, capture.prev_frame, count, [](size_t, size_t, size_t) {});
+
+    write_varint(file, slot.frame);
+    write_varint(file, slot.tick);
+    write_varint(file, num_runs);
+    for_each_changed_run(slot.pixels, capture.prev_frame, count, [&](size_t skip, size_t begin, size_t length)
+    {
+        write_varint(file, skip);
+        write_varint(file, length);
+        write_pixels(file, slot.pixels + begin, length);
+    });
+
+    memcpy(capture.prev_frame, slot.pixels, count * sizeof(uint32_t));
+    if(ferror(file))
+    {
+        fprintf(stderr, "Error writing frame %llu to %s.\n", (unsigned long long)slot.frame, capture.path);
+        return false;
+    }
+    return true;
+}
+
+static void writer_main(FrameCapture* capture)
+{
+    for(;;)
+    {
+        uint64_t tail = capture->tail.load(std::memory_order_relaxed);
+        if(tail == capture->head.load(std::memory_order_acquire))
+        {
+            // The last push happens before running is cleared, so once it
+            // is, an empty queue stays empty
+            if(!capture->running.load(std::memory_order_acquire))
+            {
+                if(tail == capture->head.load(std::memory_order_acquire)) break;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(capture->mutex);
+            capture->wake.wait_for(lock, CAPTURE_WRITER_POLL);
+            continue;
+        }
+
+        const CaptureSlot& slot = capture->slots[tail % capture->num_slots];
+        if(!capture->failed)
+        {
+            bool ok = capture->format == CAPTURE_FORMAT_PNG
+                ? write_png(*capture, slot)
+                : write_stream_frame(*capture, slot);
+            if(ok) ++capture->written;
+            else capture->failed = true;
+        }
+
+        capture->tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+bool frame_capture_start(
+    FrameCapture& capture, size_t width, size_t height,
+    CaptureFormat format, const char* path, size_t every, size_t num_slots
+)
+{
+    capture.width = width;
+    capture.height = height;
+    capture.format = format;
+    capture.path = path;
+    capture.every = every ? every : 1;
+    capture.num_slots = num_slots ? num_slots : 1;
+    capture.stream = NULL;
+    capture.prev_frame = NULL;
+    capture.rgba = NULL;
+
+    if(format == CAPTURE_FORMAT_PNG)
+    {
+        if(!CAPTURE_PNG)
+        {
+            fprintf(stderr, "Error: PNG capture needs the stb submodule (git submodule update --init).\n");
+            return false;
+        }
+        if(!png_pattern_valid(path))
+        {
+            fprintf(stderr, "Error: PNG capture path %s needs exactly one %%llu for the frame number.\n", path);
+            return false;
+        }
+        capture.rgba = new uint8_t[width * height * 4];
+    }
+    else
+    {
+        capture.stream = fopen(path, "wb");
+        if(!capture.stream)
+        {
+            fprintf(stderr, "Error opening %s for writing.\n", path);
+            return false;
+        }
+        fwrite(STREAM_MAGIC, 1, sizeof(STREAM_MAGIC), capture.stream);
+        fputc(STREAM_VERSION, capture.stream);
+        write_varint(capture.stream, width);
+        write_varint(capture.stream, height);
+        capture.prev_frame = new uint32_t[width * height]();
+    }
+
+    // All slot pixels in one block, so the pool is a single allocation
+    capture.slots = new CaptureSlot[capture.num_slots];
+    uint32_t* pixels = new uint32_t[capture.num_slots * width * height];
+    for(size_t i = 0; i < capture.num_slots; ++i)
+    {
+        capture.slots[i].pixels = pixels + i * width * height;
+    }
+
+    capture.head.store(0, std::memory_order_relaxed);
+    capture.tail.store(0, std::memory_order_relaxed);
+    capture.frames_seen = 0;
+    capture.captured = 0;
+    capture.dropped = 0;
+    capture.max_queue_depth = 0;
+    capture.written = 0;
+    capture.failed = false;
+
+    capture.running.store(true);
+    capture.writer = std::thread(writer_main, &capture);
+    return true;
+}
+
+bool frame_capture_stop(FrameCapture& capture)
+{
+    capture.running.store(false, std::memory_order_release);
+    capture.wake.notify_one();
+    capture.writer.join();
+
+    if(capture.stream && fclose(capture.stream) != 0 && !capture.failed)
+    {
+        fprintf(stderr, "Error writing %s.\n", capture.path);
+        capture.failed = true;
+    }
+    delete[] capture.slots[0].pixels;
+    delete[] capture.slots;
+    delete[] capture.prev_frame;
+    delete[] capture.rgba;
+    capture.stream = NULL;
+    capture.slots = NULL;
+    capture.prev_frame = NULL;
+    capture.rgba = NULL;
+    return !capture.failed;
+}
+
+// Claims the next free slot for this frame, or returns NULL if the frame
+// is skipped or the pool is full
+static CaptureSlot* claim_slot(FrameCapture& capture, size_t width, size_t height)
+{
+    if(width != capture.width || height != capture.height) return NULL;
+    if(capture.frames_seen++ % capture.every) return NULL;
+
+    uint64_t head = capture.head.load(std::memory_order_relaxed);
+    if(head - capture.tail.load(std::memory_order_acquire) == capture.num_slots)
+    {
+        ++capture.dropped;
+        return NULL;
+    }
+
+    CaptureSlot& slot = capture.slots[head % capture.num_slots];
+    slot.frame = capture.frames_seen - 1;
+    return &slot;
+}
+
+static void publish_slot(FrameCapture& capture, CaptureSlot& slot, uint64_t tick)
+{
+    slot.tick = tick;
+    uint64_t head = capture.head.load(std::memory_order_relaxed) + 1;
+    capture.head.store(head, std::memory_order_release);
+    capture.wake.notify_one();
+
+    ++capture.captured;
+    size_t depth = head - capture.tail.load(std::memory_order_relaxed);
+    if(depth > capture.max_queue_depth) capture.max_queue_depth = depth;
+}
+
+bool frame_capture_push(FrameCapture& capture, const Buffer& frame, uint64_t tick)
+{
+    PROFILE_SCOPE(PROFILE_CAPTURE);
+    CaptureSlot* slot = claim_slot(capture, frame.width, frame.height);
+    if(!slot) return false;
+
+    memcpy(slot->pixels, frame.data, frame.width * frame.height * sizeof(uint32_t));
+    publish_slot(capture, *slot, tick);
+    return true;
+}
+
+bool frame_capture_push(FrameCapture& capture, const IndexedBuffer& frame, const uint32_t* palette, uint64_t tick)
+{
+    PROFILE_SCOPE(PROFILE_CAPTURE);
+    CaptureSlot* slot = claim_slot(capture, frame.width, frame.height);
+    if(!slot) return false;
+
+    Buffer pixels = {frame.width, frame.height, slot->pixels};
+    indexed_buffer_resolve(frame, palette, &pixels);
+    publish_slot(capture, *slot, tick);
+    return true;
+}
+
+size_t frame_capture_queue_depth(const FrameCapture& capture)
+{
+    return capture.head.load(std::memory_order_relaxed) - capture.tail.load(std::memory_order_relaxed);
+}
+
+void frame_capture_print_stats(const FrameCapture& capture, FILE* file)
+{
+    fprintf(
+        file, "Capture: %llu frames queued, %llu dropped, max queue depth %zu of %zu%s\n",
+        (unsigned long long)capture.captured, (unsigned long long)capture.dropped,
+        capture.max_queue_depth, capture.num_slots, capture.failed ? ", write failed" : ""
+    );
+}
+
+bool frame_stream_open(FrameStreamReader& reader, const char* path)
+{
+    reader = {};
+    reader.file = fopen(path, "rb");
+    if(!reader.file)
+    {
+        fprintf(stderr, "Error opening %s for reading.\n", path);
+        return false;
+    }
+
+    char magic[4];
+    uint64_t width = 0, height = 0;
+    // Each side is bounded before the area so the product cannot wrap
+    bool ok = fread(magic, 1, sizeof(magic), reader.file) == sizeof(magic) &&
+              memcmp(magic, STREAM_MAGIC, sizeof(magic)) == 0 &&
+              fgetc(reader.file) == STREAM_VERSION &&
+              read_varint(reader.file, width) &&
+              read_varint(reader.file, height) &&
+              width && height && width <= (1u << 16) && height <= (1u << 16) &&
+              width * height <= (1u << 28);
+    if(!ok)
+    {
+        fprintf(stderr, "Error reading frame stream %s.\n", path);
+        fclose(reader.file);
+        reader.file = NULL;
+        return false;
+    }
+
+    reader.frame.width = width;
+    reader.frame.height = height;
+    reader.frame.data = new uint32_t[width * height]();
+    return true;
+}
+
+void frame_stream_close(FrameStreamReader& reader)
+{
+    if(reader.file) fclose(reader.file);
+    delete[] reader.frame.data;
+    reader = {};
+}
+
+bool frame_stream_next(FrameStreamReader& reader)
+{
+    uint64_t num_runs;
+    if(!read_varint(reader.file, reader.frame_number) ||
+       !read_varint(reader.file, reader.tick) ||
+       !read_varint(reader.file, num_runs))
+    {
+        return false;
+    }
+
+    size_t count = reader.frame.width * reader.frame.height;
+    size_t end = 0;
+    for(uint64_t i = 0; i < num_runs; ++i)
+    {
+        uint64_t skip, length;
+        if(!read_varint(reader.file, skip) || !read_varint(reader.file, length) ||
+           skip > count - end || length > count - end - skip)
+        {
+            return false;
+        }
+
+        end += skip;
+        if(!read_pixels(reader.file, reader.frame.data + end, length)) return false;
+        end += length;
+    }
+
+    return true;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "sprite.h"
+
+// PNG output needs stb_image_write.h from the stb submodule; the build
+// defines this to 1 when it is checked out
+#ifndef CAPTURE_PNG
+#define CAPTURE_PNG 0
+#endif
+
+enum CaptureFormat: uint8_t
+{
+    // One PNG per frame; the path is a printf pattern with exactly one
+    // unsigned long long conversion for the frame number, such as
+    // "frames/%06llu.png"
+    CAPTURE_FORMAT_PNG,
+    // Every frame in one file as the pixels that changed since the last:
+    //
+    //   "SIFS" | version u8 | width varint | height varint
+    //   | (frame varint | tick varint | num_runs varint
+    //      | (skip varint | length varint | pixel u32 LE * length) * num_runs)*
+    //
+    // skip counts unchanged pixels since the end of the previous run, in
+    // buffer order. The first frame is diffed against an all-zero frame.
+    CAPTURE_FORMAT_STREAM
+};
+
+struct CaptureSlot
+{
+    uint64_t frame;
+    uint64_t tick;
+    uint32_t* pixels;
+};
+
+// Copies frames into a fixed pool of slots and hands them to a writer
+// thread that encodes them. The render thread never waits: when every slot
+// is still queued the frame is dropped and counted instead.
+struct FrameCapture
+{
+    size_t width, height;
+    CaptureFormat format;
+    const char* path;
+    // Only one frame in every is captured
+    size_t every;
+
+    // Single-producer single-consumer ring of slots; the render thread
+    // fills slots[head % num_slots] and the writer drains from tail
+    CaptureSlot* slots;
+    size_t num_slots;
+    std::atomic<uint64_t> head;
+    char head_padding[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail;
+    char tail_padding[64 - sizeof(std::atomic<uint64_t>)];
+
+    // Written by the render thread only
+    uint64_t frames_seen;
+    uint64_t captured;
+    uint64_t dropped;
+    size_t max_queue_depth;
+
+    // Owned by the writer thread until frame_capture_stop returns
+    FILE* stream;
+    uint32_t* prev_frame;
+    uint8_t* rgba;
+    uint64_t written;
+    bool failed;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> running;
+};
+
+// Returns false if the output could not be opened, the PNG path pattern is
+// not valid, or PNG support is not compiled in
+bool frame_capture_start(
+    FrameCapture& capture, size_t width, size_t height,
+    CaptureFormat format, const char* path, size_t every, size_t num_slots
+);
+// Writes out everything still queued, then joins the writer. Returns false
+// if any frame or the stream itself failed to write; the writer stops
+// writing after the first failure.
+bool frame_capture_stop(FrameCapture& capture);
+
+// Render thread side. Returns true if the frame was queued; false if it
+// was skipped by every or dropped because the writer is behind. An indexed
+// frame is expanded through palette as it is copied.
+bool frame_capture_push(FrameCapture& capture, const Buffer& frame, uint64_t tick);
+bool frame_capture_push(FrameCapture& capture, const IndexedBuffer& frame, const uint32_t* palette, uint64_t tick);
+
+size_t frame_capture_queue_depth(const FrameCapture& capture);
+void frame_capture_print_stats(const FrameCapture& capture, FILE* file);
+
+// Reads a CAPTURE_FORMAT_STREAM file back frame by frame, e.g. to compare
+// a session against golden output
+struct FrameStreamReader
+{
+    FILE* file;
+    Buffer frame;
+    uint64_t frame_number;
+    uint64_t tick;
+};
+
+bool frame_stream_open(FrameStreamReader& reader, const char* path);
+void frame_stream_close(FrameStreamReader& reader);
+// Applies the next frame's runs to reader.frame; false at the end of the
+// stream or on a malformed frame
+bool frame_stream_next(FrameStreamReader& reader);
@@ -0,0 +1,167 @@
+#include "entities.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+bool alien_store_init(AlienStore& aliens, size_t count, Arena& arena, uint32_t generation)
+{
+    // The 32-bit arrays first, so every array stays aligned
+    uint8_t* storage = (uint8_t*)arena_alloc(arena, count * (3 * sizeof(uint32_t) + 2 * sizeof(int16_t) + 2 * sizeof(uint8_t)));
+    if(!storage) return false;
+
+    aliens.count = count;
+    aliens.num_live = aliens.num_shown = count;
+    aliens.slot = (uint32_t*)storage;
+    aliens.slot_index = aliens.slot + count;
+    aliens.generation = aliens.slot_index + count;
+    aliens.x = (int16_t*)(aliens.generation + count);
+    aliens.y = aliens.x + count;
+    aliens.type = (uint8_t*)(aliens.y + count);
+    aliens.death_timer = aliens.type + count;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        aliens.slot[i] = aliens.slot_index[i] = (uint32_t)i;
+        aliens.generation[i] = generation;
+    }
+    return true;
+}
+
+void alien_store_copy(AlienStore& dst, const AlienStore& src)
+{
+    dst.num_live = src.num_live;
+    dst.num_shown = src.num_shown;
+    memcpy(dst.slot, src.slot, src.count * (3 * sizeof(uint32_t) + 2 * sizeof(int16_t) + 2 * sizeof(uint8_t)));
+}
+
+static bool bullet_store_alloc(BulletStore& bullets, size_t capacity)
+{
+    int16_t* storage = arena_alloc_array<int16_t>(*bullets.arena, 3 * capacity);
+    if(!storage) return false;
+
+    if(bullets.count)
+    {
+        memcpy(storage, bullets.x, bullets.count * sizeof(int16_t));
+        memcpy(storage + capacity, bullets.y, bullets.count * sizeof(int16_t));
+        memcpy(storage + 2 * capacity, bullets.dir, bullets.count * sizeof(int16_t));
+    }
+    bullets.x = storage;
+    bullets.y = storage + capacity;
+    bullets.dir = storage + 2 * capacity;
+    bullets.capacity = capacity;
+    return true;
+}
+
+bool bullet_store_init(BulletStore& bullets, size_t max_count, Arena& arena, size_t initial_capacity)
+{
+    bullets = {};
+    bullets.max_count = max_count;
+    bullets.arena = &arena;
+    size_t capacity = std::max<size_t>(std::min(initial_capacity, max_count), 1);
+    if(!bullet_store_alloc(bullets, capacity)) return false;
+    if(capacity >= max_count) bullets.arena = NULL;
+    return true;
+}
+
+bool bullet_store_reserve(BulletStore& bullets, size_t count)
+{
+    if(count <= bullets.capacity) return true;
+    if(count > bullets.max_count || !bullets.arena) return false;
+
+    size_t capacity = bullets.capacity;
+    while(capacity < count) capacity = std::min(2 * capacity, bullets.max_count);
+    return bullet_store_alloc(bullets, capacity);
+}
+
+void bullet_store_copy(BulletStore& dst, const BulletStore& src)
+{
+    dst.count = src.count;
+    memcpy(dst.x, src.x, src.count * sizeof(int16_t));
+    memcpy(dst.y, src.y, src.count * sizeof(int16_t));
+    memcpy(dst.dir, src.dir, src.count * sizeof(int16_t));
+}
+
+AlienHandle alien_handle(const AlienStore& aliens, uint32_t slot)
+{
+    return {slot, aliens.generation[slot]};
+}
+
+bool alien_resolve(const AlienStore& aliens, AlienHandle handle, size_t& index)
+{
+    if(handle.slot >= aliens.count || aliens.generation[handle.slot] != handle.generation) return false;
+    index = aliens.slot_index[handle.slot];
+    return true;
+}
+
+static void aliens_swap(AlienStore& aliens, size_t a, size_t b)
+{
+    std::swap(aliens.x[a], aliens.x[b]);
+    std::swap(aliens.y[a], aliens.y[b]);
+    std::swap(aliens.type[a], aliens.type[b]);
+    std::swap(aliens.death_timer[a], aliens.death_timer[b]);
+    std::swap(aliens.slot[a], aliens.slot[b]);
+    aliens.slot_index[aliens.slot[a]] = (uint32_t)a;
+    aliens.slot_index[aliens.slot[b]] = (uint32_t)b;
+}
+
+void aliens_kill(AlienStore& aliens, size_t index)
+{
+    aliens_swap(aliens, index, --aliens.num_live);
+}
+
+size_t aliens_update_death_timers(AlienStore& aliens, uint32_t* expired)
+{
+    // Every entry in the range has a timer of at least one
+    uint8_t* __restrict death_timer = aliens.death_timer;
+    const size_t begin = aliens.num_live, end = aliens.num_shown;
+    for(size_t ai = begin; ai < end; ++ai)
+    {
+        --death_timer[ai];
+    }
+
+    // Back to front, so whatever is swapped in has already been looked at
+    size_t num_expired = 0;
+    for(size_t ai = end; ai-- > begin;)
+    {
+        if(death_timer[ai]) continue;
+
+        uint32_t slot = aliens.slot[ai];
+        expired[num_expired++] = slot;
+        ++aliens.generation[slot];
+        aliens_swap(aliens, ai, --aliens.num_shown);
+    }
+    return num_expired;
+}
+
+void bullets_advance(BulletStore& bullets)
+{
+    int16_t* __restrict y = bullets.y;
+    const int16_t* __restrict dir = bullets.dir;
+    const size_t count = bullets.count;
+    for(size_t bi = 0; bi < count; ++bi)
+    {
+        y[bi] += dir[bi];
+    }
+}
+
+bool bullets_spawn(BulletStore& bullets, int16_t x, int16_t y, int16_t dir)
+{
+    if(bullets.count == bullets.capacity && !bullet_store_reserve(bullets, bullets.count + 1)) return false;
+
+    bullets.x[bullets.count] = x;
+    bullets.y[bullets.count] = y;
+    bullets.dir[bullets.count] = dir;
+    ++bullets.count;
+
+    return true;
+}
+
+void bullets_remove(BulletStore& bullets, size_t bi)
+{
+    size_t last = bullets.count - 1;
+    bullets.x[bi] = bullets.x[last];
+    bullets.y[bi] = bullets.y[last];
+    bullets.dir[bi] = bullets.dir[last];
+    --bullets.count;
+}
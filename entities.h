@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.h"
+
+// Default cap on bullets in flight, and the capacity a store starts with
+constexpr int GAME_MAX_BULLETS = 128;
+
+enum AlienType: uint8_t
+{
+    ALIEN_DEAD   = 0,
+    ALIEN_TYPE_A = 1,
+    ALIEN_TYPE_B = 2,
+    ALIEN_TYPE_C = 3
+};
+
+// Aliens as parallel arrays, so each update kernel only streams the fields
+// it reads. Coordinates are signed and may go negative as the formation
+// drops off the bottom of the playfield.
+//
+// The arrays are kept dense by state, so loops only visit the aliens they
+// care about:
+//
+//   [0, num_live) alive | [num_live, num_shown) death sprite | [num_shown, count) gone
+//
+// Each alien also owns a fixed slot, its place in the formation. Entries
+// move between ranges by swap-remove, and slot_index follows them, so an
+// AlienHandle resolves to the same alien wherever it currently sits.
+struct AlienStore
+{
+    size_t count;
+    size_t num_live, num_shown;
+    int16_t* x;
+    int16_t* y;
+    uint8_t* type;
+    // Ticks the death sprite stays on screen once an alien is ALIEN_DEAD
+    uint8_t* death_timer;
+    // Slot of each entry, and the entry holding each slot
+    uint32_t* slot;
+    uint32_t* slot_index;
+    // Per slot; bumped when its alien is gone, so old handles stop resolving
+    uint32_t* generation;
+};
+
+// Names an alien independently of where its entry currently sits
+struct AlienHandle
+{
+    uint32_t slot;
+    uint32_t generation;
+};
+
+// Bullets as parallel arrays in arena memory. They start at a small
+// capacity and double on demand up to max_count, each time moving to a
+// fresh block of the arena; the old blocks go back when the arena is reset.
+struct BulletStore
+{
+    size_t count, capacity, max_count;
+    int16_t* x;
+    int16_t* y;
+    int16_t* dir;
+    // Where growth comes from; NULL for a store that never grows
+    Arena* arena;
+};
+
+// Bytes alien_store_init takes from an arena for count aliens
+constexpr size_t alien_store_bytes(size_t count)
+{
+    return arena_size_for(count * (3 * sizeof(uint32_t) + 2 * sizeof(int16_t) + 2 * sizeof(uint8_t)));
+}
+
+// Carves all arrays for count aliens out of one arena allocation; they are
+// released with the arena. Every alien starts alive in the entry matching
+// its slot, with handles of the given generation.
+bool alien_store_init(AlienStore& aliens, size_t count, Arena& arena, uint32_t generation = 0);
+// dst must have been initialised with the same count as src
+void alien_store_copy(AlienStore& dst, const AlienStore& src);
+
+// Bytes bullet_store_init and every later doubling can take from an arena
+constexpr size_t bullet_store_bytes(size_t max_count, size_t initial_capacity)
+{
+    size_t bytes = 0;
+    size_t capacity = initial_capacity < max_count ? initial_capacity : max_count;
+    if(capacity == 0) capacity = 1;
+    for(;;)
+    {
+        bytes += arena_size_for(capacity * 3 * sizeof(int16_t));
+        if(capacity >= max_count) break;
+        capacity = 2 * capacity < max_count ? 2 * capacity : max_count;
+    }
+    return bytes;
+}
+
+// Starts empty with room for initial_capacity bullets (at least one). With
+// initial_capacity equal to max_count the store is allocated whole and
+// never grows.
+bool bullet_store_init(BulletStore& bullets, size_t max_count, Arena& arena, size_t initial_capacity);
+// Grows until count bullets fit; false past max_count or if the arena is full
+bool bullet_store_reserve(BulletStore& bullets, size_t count);
+// dst must have room for src.count bullets
+void bullet_store_copy(BulletStore& dst, const BulletStore& src);
+
+AlienHandle alien_handle(const AlienStore& aliens, uint32_t slot);
+// Sets index to the alien's current entry. False once it is gone, or if the
+// handle is from an earlier level.
+bool alien_resolve(const AlienStore& aliens, AlienHandle handle, size_t& index);
+
+// Moves a live entry to the front of the death sprite range; it sits at
+// num_live afterwards. The caller sets its type and position.
+void aliens_kill(AlienStore& aliens, size_t index);
+
+// Counts down the death sprite range and moves the entries that reach zero
+// out of it, writing their slots to expired. Returns how many there were.
+size_t aliens_update_death_timers(AlienStore& aliens, uint32_t* expired);
+
+// Branch-free kernels over whole arrays, written so the compiler can
+// vectorize them
+void bullets_advance(BulletStore& bullets);
+
+// Grows the store when it is full; false once it holds max_count
+bool bullets_spawn(BulletStore& bullets, int16_t x, int16_t y, int16_t dir);
+// Swap-remove, so bullet order is not preserved
+void bullets_remove(BulletStore& bullets, size_t bi);
@@ -0,0 +1,73 @@
+#include "env.h"
+
+bool env_runner_init(EnvRunner& runner, size_t num_envs, size_t num_threads, bool render)
+{
+    runner = {};
+    runner.pool = thread_pool_create(num_threads);
+    runner.num_envs = num_envs;
+    runner.render = render;
+    runner.worlds = new World[num_envs]();
+    for(size_t i = 0; i < num_envs; ++i)
+    {
+        if(world_init(runner.worlds[i], render)) continue;
+
+        // Only the worlds before this one need tearing down
+        runner.num_envs = i;
+        env_runner_destroy(runner);
+        return false;
+    }
+    return true;
+}
+
+void env_runner_destroy(EnvRunner& runner)
+{
+    for(size_t i = 0; i < runner.num_envs; ++i)
+    {
+        world_destroy(runner.worlds[i]);
+    }
+    delete[] runner.worlds;
+    thread_pool_destroy(runner.pool);
+    runner = {};
+}
+
+static void env_tick(EnvRunner& runner, size_t env, const Input& input)
+{
+    World& world = runner.worlds[env];
+    world_tick(world, input);
+    if(runner.render) world_draw(world, 1.0);
+}
+
+static void step_env(void* data, size_t env)
+{
+    EnvRunner& runner = *(EnvRunner*)data;
+    env_tick(runner, env, runner.inputs[env]);
+}
+
+static void run_env(void* data, size_t env)
+{
+    EnvRunner& runner = *(EnvRunner*)data;
+    for(size_t step = 0; step < runner.num_steps; ++step)
+    {
+        Input input = runner.policy(runner.policy_data, env, runner.worlds[env]);
+        env_tick(runner, env, input);
+    }
+}
+
+void env_runner_step(EnvRunner& runner, const Input* inputs)
+{
+    runner.inputs = inputs;
+    thread_pool_for(runner.pool, runner.num_envs, step_env, &runner);
+}
+
+void env_runner_run(EnvRunner& runner, size_t num_steps, EnvPolicy policy, void* data)
+{
+    runner.policy = policy;
+    runner.policy_data = data;
+    runner.num_steps = num_steps;
+    thread_pool_for(runner.pool, runner.num_envs, run_env, &runner);
+}
+
+bool env_runner_reset(EnvRunner& runner, size_t env)
+{
+    return world_restart(runner.worlds[env]);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#include "game.h"
+#include "thread_pool.h"
+
+// Picks the input for one env's next tick from its current state
+typedef Input (*EnvPolicy)(void* data, size_t env, const World& world);
+
+// Steps many independent worlds in parallel on a thread pool, for bots and
+// batch balance runs. Each env owns its world and, when rendering, draws
+// its own framebuffer after every tick.
+struct EnvRunner
+{
+    ThreadPool* pool;
+    size_t num_envs;
+    World* worlds;
+    bool render;
+
+    // Per-call job state read by the workers
+    const Input* inputs;
+    EnvPolicy policy;
+    void* policy_data;
+    size_t num_steps;
+};
+
+// num_threads as for thread_pool_create. Returns false, with nothing left
+// to destroy, if a world could not be built.
+bool env_runner_init(EnvRunner& runner, size_t num_envs, size_t num_threads, bool render);
+void env_runner_destroy(EnvRunner& runner);
+
+// One tick of every env in lockstep, env i taking inputs[i]
+void env_runner_step(EnvRunner& runner, const Input* inputs);
+
+// num_steps ticks of every env, asking policy for each input. Envs do not
+// wait for each other, so the whole batch is a single dispatch.
+void env_runner_run(EnvRunner& runner, size_t num_steps, EnvPolicy policy, void* data);
+
+bool env_runner_reset(EnvRunner& runner, size_t env);
@@ -0,0 +1,878 @@
+#include "game.h"
+#include "profiler.h"
+#include "sprite_art.h"
+
+#include <algorithm>
+#include <cstdio>
+
+size_t update_aliens_position(Game& game)
+{
+    const int pixels_to_drop = 5;
+    const uint64_t min_delta_ticks = 3 * SIM_TICKS_PER_SECOND;
+
+    if(game.tick - game.last_alien_drop_tick > min_delta_ticks)
+    {
+        game.last_alien_drop_tick = game.tick;
+        formation_step(game.formation, 0, -pixels_to_drop);
+
+        return pixels_to_drop;
+    }
+
+    return 0;
+}
+
+// Sprite art, baked into packed bitmaps at compile time
+
+constexpr char alien_a0_art[][9] = {
+    "...@@...",
+    "..@@@@..",
+    ".@@@@@@.",
+    "@@.@@.@@",
+    "@@@@@@@@",
+    ".@.@@.@.",
+    "@......@",
+    ".@....@."
+};
+
+constexpr char alien_a1_art[][9] = {
+    "...@@...",
+    "..@@@@..",
+    ".@@@@@@.",
+    "@@.@@.@@",
+    "@@@@@@@@",
+    "..@..@..",
+    ".@.@@.@.",
+    "@.@..@.@"
+};
+
+constexpr char alien_b0_art[][12] = {
+    "..@.....@..",
+    "...@...@...",
+    "..@@@@@@@..",
+    ".@@.@@@.@@.",
+    "@@@@@@@@@@@",
+    "@.@@@@@@@.@",
+    "@.@.....@.@",
+    "...@@.@@..."
+};
+
+constexpr char alien_b1_art[][12] = {
+    "..@.....@..",
+    "@..@...@..@",
+    "@.@@@@@@@.@",
+    "@@@.@@@.@@@",
+    "@@@@@@@@@@@",
+    ".@@@@@@@@@.",
+    "..@.....@..",
+    ".@.......@."
+};
+
+constexpr char alien_c0_art[][13] = {
+    "....@@@@....",
+    ".@@@@@@@@@@.",
+    "@@@@@@@@@@@@",
+    "@@@..@@..@@@",
+    "@@@@@@@@@@@@",
+    "...@@..@@...",
+    "..@@.@@.@@..",
+    "@@........@@"
+};
+
+constexpr char alien_c1_art[][13] = {
+    "....@@@@....",
+    ".@@@@@@@@@@.",
+    "@@@@@@@@@@@@",
+    "@@@..@@..@@@",
+    "@@@@@@@@@@@@",
+    "..@@@..@@@..",
+    ".@@..@@..@@.",
+    "..@@....@@.."
+};
+
+constexpr char alien_death_art[][14] = {
+    ".@..@...@..@.",
+    "..@..@.@..@..",
+    "...@.....@...",
+    "@@.........@@",
+    "...@.....@...",
+    "..@..@.@..@..",
+    ".@..@...@..@."
+};
+
+constexpr char player_art[][12] = {
+    ".....@.....",
+    "....@@@....",
+    "....@@@....",
+    ".@@@@@@@@@.",
+    "@@@@@@@@@@@",
+    "@@@@@@@@@@@",
+    "@@@@@@@@@@@"
+};
+
+constexpr char bullet_art[][2] = {
+    "@",
+    "@",
+    "@"
+};
+
+constexpr char bunker_art[][23] = {
+    "....@@@@@@@@@@@@@@....",
+    "...@@@@@@@@@@@@@@@@...",
+    "..@@@@@@@@@@@@@@@@@@..",
+    ".@@@@@@@@@@@@@@@@@@@@.",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@@@@@@@@@@@@@@@",
+    "@@@@@@@@......@@@@@@@@",
+    "@@@@@@@........@@@@@@@",
+    "@@@@@@..........@@@@@@",
+    "@@@@@@..........@@@@@@"
+};
+
+constexpr char bunker_explosion_art[][7] = {
+    "@..@.@",
+    ".@@@@.",
+    "@@@@@@",
+    "@@@@@@",
+    ".@@@@.",
+    "@.@@.@"
+};
+
+static_assert(sprite_art_valid(alien_a0_art), "alien_a0_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(alien_a1_art), "alien_a1_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(alien_b0_art), "alien_b0_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(alien_b1_art), "alien_b1_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(alien_c0_art), "alien_c0_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(alien_c1_art), "alien_c1_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(alien_death_art), "alien_death_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(player_art), "player_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(bullet_art), "bullet_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(bunker_art), "bunker_art rows must be equal width and only use '@' and '.'");
+static_assert(sprite_art_valid(bunker_explosion_art), "bunker_explosion_art rows must be equal width and only use '@' and '.'");
+
+constexpr SpriteAtlas game_atlas = {{
+    bake_packed_sprite(alien_a0_art),
+    bake_packed_sprite(alien_a1_art),
+    bake_packed_sprite(alien_b0_art),
+    bake_packed_sprite(alien_b1_art),
+    bake_packed_sprite(alien_c0_art),
+    bake_packed_sprite(alien_c1_art),
+    bake_packed_sprite(alien_death_art),
+    bake_packed_sprite(player_art),
+    bake_packed_sprite(bullet_art),
+    bake_packed_sprite(bunker_art),
+    bake_packed_sprite(bunker_explosion_art)
+}};
+
+constexpr AlienAnimation alien_animations[NUM_OF_ALIEN_TYPES] = {
+    {SPRITE_ALIEN_A_0, 2, 10},
+    {SPRITE_ALIEN_B_0, 2, 10},
+    {SPRITE_ALIEN_C_0, 2, 10}
+};
+
+// All frames of an alien are drawn at the same position, so they must match
+static_assert(game_atlas.frames[SPRITE_ALIEN_A_0].width == game_atlas.frames[SPRITE_ALIEN_A_1].width &&
+              game_atlas.frames[SPRITE_ALIEN_B_0].width == game_atlas.frames[SPRITE_ALIEN_B_1].width &&
+              game_atlas.frames[SPRITE_ALIEN_C_0].width == game_atlas.frames[SPRITE_ALIEN_C_1].width,
+              "alien animation frames differ in width");
+static_assert(game_atlas.frames[SPRITE_ALIEN_A_0].height == game_atlas.frames[SPRITE_ALIEN_B_0].height &&
+              game_atlas.frames[SPRITE_ALIEN_A_0].height == game_atlas.frames[SPRITE_ALIEN_C_0].height,
+              "alien types differ in height");
+
+void animation_clock_init(AnimationClock& clock)
+{
+    for(size_t i = 0; i < NUM_OF_ALIEN_TYPES; ++i)
+    {
+        clock.time[i] = 0;
+        clock.type_frame[i + 1] = alien_animations[i].first_frame;
+    }
+    clock.type_frame[ALIEN_DEAD] = SPRITE_ALIEN_DEATH;
+}
+
+void animation_clock_advance(AnimationClock& clock)
+{
+    for(size_t i = 0; i < NUM_OF_ALIEN_TYPES; ++i)
+    {
+        const AlienAnimation& animation = alien_animations[i];
+        ++clock.time[i];
+        if(clock.time[i] == animation.num_frames * animation.frame_duration)
+        {
+            clock.time[i] = 0;
+        }
+        clock.type_frame[i + 1] = animation.first_frame + clock.time[i] / animation.frame_duration;
+    }
+}
+
+void formation_step(Formation& formation, int dx, int dy)
+{
+    formation.offset_x += dx;
+    formation.offset_y += dy;
+}
+
+bool formation_tracker_init(FormationTracker& tracker, size_t rows, size_t cols, size_t num_aliens, Arena& arena)
+{
+    // One count per row and column, but two extents
+    tracker.row_shown = arena_alloc_array<uint32_t>(arena, rows + cols);
+    tracker.row_bottom = arena_alloc_array<int16_t>(arena, 2 * (rows + cols));
+    tracker.expired = arena_alloc_array<uint32_t>(arena, num_aliens);
+    if(!tracker.row_shown || !tracker.row_bottom || !tracker.expired) return false;
+
+    tracker.col_shown = tracker.row_shown + rows;
+    tracker.row_top = tracker.row_bottom + rows;
+    tracker.col_left = tracker.row_top + rows;
+    tracker.col_right = tracker.col_left + cols;
+    return true;
+}
+
+// Grows a row's and a column's extent to cover a sprite at a local position
+static void formation_tracker_cover(
+    FormationTracker& tracker, size_t row, size_t col,
+    int16_t x, int16_t y, const PackedSprite& sprite
+)
+{
+    tracker.row_bottom[row] = std::min<int16_t>(tracker.row_bottom[row], y);
+    tracker.row_top[row] = std::max<int16_t>(tracker.row_top[row], y + sprite.height);
+    tracker.col_left[col] = std::min<int16_t>(tracker.col_left[col], x);
+    tracker.col_right[col] = std::max<int16_t>(tracker.col_right[col], x + sprite.width);
+}
+
+// Drops empty rows and columns off the edges of the slot ranges. Each one
+// leaves at most once per level, so this is O(1) amortized per death.
+static void formation_shrink(Formation& formation, const FormationTracker& tracker)
+{
+    while(formation.row_begin < formation.row_end && !tracker.row_shown[formation.row_begin]) ++formation.row_begin;
+    while(formation.row_end > formation.row_begin && !tracker.row_shown[formation.row_end - 1]) --formation.row_end;
+    while(formation.col_begin < formation.col_end && !tracker.col_shown[formation.col_begin]) ++formation.col_begin;
+    while(formation.col_end > formation.col_begin && !tracker.col_shown[formation.col_end - 1]) --formation.col_end;
+
+    if(formation.row_begin == formation.row_end || formation.col_begin == formation.col_end)
+    {
+        formation.row_begin = formation.row_end = 0;
+        formation.col_begin = formation.col_end = 0;
+    }
+}
+
+// Bottom row of a formation: 8/25 of the way up, as in the classic layout,
+// unless the top row would then stick out of the field
+static int alien_formation_y(size_t height, size_t rows)
+{
+    int extent = ALIEN_ROW_PITCH * ((int)rows - 1) + game_atlas.frames[SPRITE_ALIEN_A_0].height;
+    return std::min((int)height * 8 / 25, (int)height - extent);
+}
+
+void init_aliens(Game& game, const SpriteAtlas& atlas)
+{
+    const size_t rows = game.formation.rows, cols = game.formation.cols;
+    const int bottom = alien_formation_y(game.height, rows);
+    for(size_t yi = 0; yi < rows; ++yi)
+    {
+        for(size_t xi = 0; xi < cols; ++xi)
+        {
+            size_t ai = yi * cols + xi;
+            game.aliens.type[ai] = std::min((rows - yi) / 2 + 1,NUM_OF_ALIEN_TYPES);
+            game.aliens.death_timer[ai] = 10;
+
+            const PackedSprite& sprite = atlas.frames[alien_animations[game.aliens.type[ai] - 1].first_frame];
+
+            game.aliens.x[ai] = game.width / cols * xi + ALIEN_MARGIN_X + (atlas.frames[SPRITE_ALIEN_DEATH].width - sprite.width)/2;
+            game.aliens.y[ai] = bottom + ALIEN_ROW_PITCH * yi;
+        }
+    }
+
+}
+
+void init_bunkers(Game& game, const SpriteAtlas& atlas)
+{
+    // Evenly spread, each centred in its share of the width
+    const PackedSprite& shape = atlas.frames[SPRITE_BUNKER];
+    int16_t spacing = game.width / NUM_OF_BUNKERS;
+    bunkers_init(game.bunkers, shape, NUM_OF_BUNKERS, (spacing - shape.width) / 2, BUNKER_Y, spacing);
+}
+
+bool game_config_valid(const GameConfig& config)
+{
+    const SpriteAtlas& atlas = game_atlas;
+    if(!config.width || !config.height || config.width > GAME_MAX_DIMENSION || config.height > GAME_MAX_DIMENSION)
+    {
+        fprintf(stderr, "Error: a %zux%zu playfield is not within 1..%zu on each side\n", config.width, config.height, GAME_MAX_DIMENSION);
+        return false;
+    }
+    if(!config.alien_rows || !config.alien_cols || !config.max_bullets || config.max_bullets > UINT32_MAX)
+    {
+        fprintf(stderr, "Error: %zu alien rows, %zu columns and %zu bullets are not all in range\n", config.alien_rows, config.alien_cols, config.max_bullets);
+        return false;
+    }
+
+    // A column has to hold a death sprite, the widest an alien gets
+    size_t pitch = config.width / config.alien_cols;
+    size_t death_width = atlas.frames[SPRITE_ALIEN_DEATH].width;
+    if(pitch < death_width || ALIEN_MARGIN_X + pitch * (config.alien_cols - 1) + death_width > config.width)
+    {
+        fprintf(stderr, "Error: %zu alien columns do not fit in a width of %zu\n", config.alien_cols, config.width);
+        return false;
+    }
+
+    int bunker_top = BUNKER_Y + (int)atlas.frames[SPRITE_BUNKER].height;
+    if(config.alien_rows > config.height || alien_formation_y(config.height, config.alien_rows) < bunker_top)
+    {
+        fprintf(stderr, "Error: %zu alien rows do not fit above the bunkers in a height of %zu\n", config.alien_rows, config.height);
+        return false;
+    }
+
+    if(config.width / NUM_OF_BUNKERS < atlas.frames[SPRITE_BUNKER].width + atlas.frames[SPRITE_BULLET].width)
+    {
+        fprintf(stderr, "Error: %zu bunkers do not fit in a width of %zu\n", NUM_OF_BUNKERS, config.width);
+        return false;
+    }
+    return true;
+}
+
+bool game_config_equal(const GameConfig& a, const GameConfig& b)
+{
+    return a.width == b.width && a.height == b.height &&
+           a.alien_rows == b.alien_rows && a.alien_cols == b.alien_cols &&
+           a.max_bullets == b.max_bullets;
+}
+
+bool prepare_game(Game& game, const GameConfig& config, Arena& arena, uint32_t alien_generation)
+{
+    game.width = config.width;
+    game.height = config.height;
+    game.tick = 0;
+    game.last_alien_drop_tick = 0;
+    game.formation = {};
+    game.formation.rows = config.alien_rows;
+    game.formation.cols = config.alien_cols;
+    if(!alien_store_init(game.aliens, config.alien_rows * config.alien_cols, arena, alien_generation)) return false;
+    if(!bullet_store_init(game.bullets, config.max_bullets, arena, GAME_MAX_BULLETS)) return false;
+
+    game.player.x = config.width / 2 - 5;
+    game.player.y = 32;
+    game.player.life = 3;
+    return true;
+}
+
+void process_events(Game& game, const SpriteAtlas& atlas, bool fire_pressed)
+{
+    const PackedSprite& player_sprite = atlas.frames[SPRITE_PLAYER];
+    if(fire_pressed)
+    {
+        bullets_spawn(
+            game.bullets,
+            game.player.x + player_sprite.width / 2,
+            game.player.y + player_sprite.height,
+            2
+        );
+    }
+}
+
+void simulate_player(Game& game, const SpriteAtlas& atlas, int move_dir)
+{
+    const PackedSprite& player_sprite = atlas.frames[SPRITE_PLAYER];
+    int player_move_dir = 2 * move_dir;
+
+    if(player_move_dir != 0)
+    {
+        if(game.player.x + player_sprite.width + player_move_dir >= game.width)
+        {
+            game.player.x = game.width - player_sprite.width;
+        }
+        else if((int)game.player.x + player_move_dir <= 0)
+        {
+            game.player.x = 0;
+        }
+        else game.player.x += player_move_dir;
+    }
+}
+
+// Both animation frames of a type share a size, so the first one gives the
+// rectangle an alien occupies in the grid
+static const PackedSprite& alien_type_sprite(const World& world, uint8_t type)
+{
+    return world.atlas->frames[alien_animations[type - 1].first_frame];
+}
+
+bool world_init(World& world, bool framebuffer, const GameConfig& config)
+{
+    if(!game_config_valid(config)) return false;
+
+    world.config = config;
+    const size_t width = config.width, height = config.height;
+    const size_t num_aliens = config.alien_rows * config.alien_cols;
+
+    // Session memory first, then the level, so a restart only rolls back
+    // the level part
+    size_t buffer_bytes = 0;
+    if(framebuffer)
+    {
+        buffer_bytes =
+            arena_size_for(width * height * sizeof(uint32_t)) +
+            arena_size_for(width * height);
+    }
+    arena_init(
+        world.arena,
+        buffer_bytes + arena_size_for(config.max_bullets * sizeof(uint32_t)) +
+        alien_store_bytes(num_aliens) +
+        bullet_store_bytes(config.max_bullets, GAME_MAX_BULLETS) +
+        formation_tracker_bytes(config.alien_rows, config.alien_cols, num_aliens)
+    );
+
+    world.buffer = {};
+    world.indexed_buffer = {};
+    if(framebuffer)
+    {
+        world.buffer.width  = width;
+        world.buffer.height = height;
+        world.buffer.data   = arena_alloc_array<uint32_t>(world.arena, world.buffer.width * world.buffer.height);
+        world.indexed_buffer.width  = width;
+        world.indexed_buffer.height = height;
+        world.indexed_buffer.data   = arena_alloc_array<uint8_t>(world.arena, world.indexed_buffer.width * world.indexed_buffer.height);
+    }
+    world.indexed = false;
+    world.bullet_scratch = arena_alloc_array<uint32_t>(world.arena, config.max_bullets);
+
+    for(size_t i = 0; i < PALETTE_SIZE; ++i) world.palette[i] = rgb_to_uint32(0, 0, 0);
+    world.palette[PALETTE_BACKGROUND] = rgb_to_uint32(0, 128, 0);
+    world.palette[PALETTE_SPRITE] = rgb_to_uint32(128, 0, 0);
+
+    world.atlas = &game_atlas;
+
+    // The draw list grows on its own if the bullets outgrow their start
+    draw_list_init(world.draw_list, NUM_OF_BUNKERS + num_aliens + GAME_MAX_BULLETS + 1);
+    dirty_tracker_init(world.dirty, width, height, DIRTY_TILE_SIZE);
+    world.band_renderer = NULL;
+    grid_init(world.alien_grid, width, height, ALIEN_GRID_CELL_SIZE);
+
+    world.level_mark = arena_mark(world.arena);
+    world.next_alien_generation = 0;
+
+    bool buffers_ok = !framebuffer || (world.buffer.data && world.indexed_buffer.data);
+    if(!buffers_ok || !world.bullet_scratch || !world_restart(world))
+    {
+        world_destroy(world);
+        return false;
+    }
+    return true;
+}
+
+bool world_restart(World& world)
+{
+    arena_reset(world.arena, world.level_mark);
+    Game& game = world.game;
+    if(!prepare_game(game, world.config, world.arena, world.next_alien_generation)) return false;
+    // A slot's generation goes up at most once per level
+    world.next_alien_generation += 2;
+    init_aliens(game, *world.atlas);
+    init_bunkers(game, *world.atlas);
+    bool tracker_ok = formation_tracker_init(
+        world.formation_tracker, game.formation.rows, game.formation.cols,
+        game.aliens.count, world.arena
+    );
+    if(!tracker_ok) return false;
+    animation_clock_init(world.animation_clock);
+    world.prev_player_x = game.player.x;
+    world_rebuild_alien_index(world);
+    return true;
+}
+
+void world_rebuild_alien_index(World& world)
+{
+    Game& game = world.game;
+    const AlienStore& aliens = game.aliens;
+    Formation& formation = game.formation;
+    FormationTracker& tracker = world.formation_tracker;
+    const SpriteAtlas& atlas = *world.atlas;
+
+    grid_clear(world.alien_grid);
+    for(size_t row = 0; row < formation.rows; ++row)
+    {
+        tracker.row_shown[row] = 0;
+        tracker.row_bottom[row] = INT16_MAX;
+        tracker.row_top[row] = INT16_MIN;
+    }
+    for(size_t col = 0; col < formation.cols; ++col)
+    {
+        tracker.col_shown[col] = 0;
+        tracker.col_left[col] = INT16_MAX;
+        tracker.col_right[col] = INT16_MIN;
+    }
+
+    for(size_t ai = 0; ai < aliens.num_shown; ++ai)
+    {
+        size_t slot = aliens.slot[ai];
+        size_t row = slot / formation.cols, col = slot % formation.cols;
+        ++tracker.row_shown[row];
+        ++tracker.col_shown[col];
+
+        if(ai >= aliens.num_live)
+        {
+            formation_tracker_cover(tracker, row, col, aliens.x[ai], aliens.y[ai], atlas.frames[SPRITE_ALIEN_DEATH]);
+            continue;
+        }
+
+        const PackedSprite& sprite = alien_type_sprite(world, aliens.type[ai]);
+        formation_tracker_cover(tracker, row, col, aliens.x[ai], aliens.y[ai], sprite);
+        grid_insert(world.alien_grid, slot, aliens.x[ai], aliens.y[ai], sprite.width, sprite.height);
+    }
+
+    formation.row_begin = 0;
+    formation.row_end = formation.rows;
+    formation.col_begin = 0;
+    formation.col_end = formation.cols;
+    formation_shrink(formation, tracker);
+}
+
+bool world_formation_rect(const World& world, int& x, int& y, int& width, int& height)
+{
+    const Formation& formation = world.game.formation;
+    const FormationTracker& tracker = world.formation_tracker;
+    if(formation.row_begin == formation.row_end) return false;
+
+    // Rows and columns are laid out in order, so the outermost ones bound
+    // everything in between
+    x = formation.offset_x + tracker.col_left[formation.col_begin];
+    y = formation.offset_y + tracker.row_bottom[formation.row_begin];
+    width = tracker.col_right[formation.col_end - 1] - tracker.col_left[formation.col_begin];
+    height = tracker.row_top[formation.row_end - 1] - tracker.row_bottom[formation.row_begin];
+    return true;
+}
+
+void world_destroy(World& world)
+{
+    grid_destroy(world.alien_grid);
+    draw_list_destroy(world.draw_list);
+    dirty_tracker_destroy(world.dirty);
+    arena_destroy(world.arena);
+}
+
+void world_set_indexed(World& world, bool indexed)
+{
+    world.indexed = indexed;
+    dirty_tracker_invalidate(world.dirty);
+}
+
+uint32_t world_color(const World& world, PaletteColor color)
+{
+    return world.indexed ? (uint32_t)color : world.palette[color];
+}
+
+void build_draw_list(
+    World& world, const Game& game, const AnimationClock& animation_clock,
+    size_t prev_player_x, double alpha
+)
+{
+    PROFILE_SCOPE(PROFILE_BUILD_DRAW_LIST);
+    DrawList& list = world.draw_list;
+    const SpriteAtlas& atlas = *world.atlas;
+
+    draw_list_clear(list);
+    uint32_t color = world_color(world, PALETTE_SPRITE);
+
+    const BunkerField& bunkers = game.bunkers;
+    for(size_t i = 0; i < bunkers.count; ++i)
+    {
+        world.bunker_sprites[i] = bunkers.masks[i];
+        draw_list_push(
+            list, world.bunker_sprites[i],
+            bunkers.x + (int)i * bunkers.spacing, bunkers.y, color, bunkers.revision[i]
+        );
+    }
+
+    draw_list_end_section(list, DRAW_SECTION_BUNKERS);
+
+    // Only the live and dying ranges; aliens never overlap, so their order
+    // does not matter
+    const AlienStore& aliens = game.aliens;
+    const Formation& formation = game.formation;
+    for(size_t ai = 0; ai < aliens.num_shown; ++ai)
+    {
+        // Dead aliens map to the death frame, so no branch on the type
+        const PackedSprite& sprite = atlas.frames[animation_clock.type_frame[aliens.type[ai]]];
+        draw_list_push(
+            list, sprite,
+            formation.offset_x + aliens.x[ai], formation.offset_y + aliens.y[ai], color
+        );
+    }
+
+    draw_list_end_section(list, DRAW_SECTION_ALIENS);
+
+    const BulletStore& bullets = game.bullets;
+    for(size_t bi = 0; bi < bullets.count; ++bi)
+    {
+        // Bullets move in a straight line, so last tick's position is y - dir
+        int bullet_y = bullets.y[bi] - bullets.dir[bi] * (1.0 - alpha);
+        draw_list_push(list, atlas.frames[SPRITE_BULLET], bullets.x[bi], bullet_y, color);
+    }
+
+    draw_list_end_section(list, DRAW_SECTION_BULLETS);
+
+    int player_x = (double)game.player.x + ((double)prev_player_x - game.player.x) * (1.0 - alpha);
+    draw_list_push(list, atlas.frames[SPRITE_PLAYER], player_x, game.player.y, color);
+    draw_list_end_section(list, DRAW_SECTION_PLAYER);
+}
+
+void world_build_draw_list(World& world, double alpha)
+{
+    build_draw_list(world, world.game, world.animation_clock, world.prev_player_x, alpha);
+}
+
+template <typename Target>
+static void world_render_into(World& world, Target* buffer, uint32_t clear_color)
+{
+    if(dirty_tracker_update(world.dirty, world.draw_list, clear_color))
+    {
+        render_draw_list_dirty(buffer, world.draw_list, clear_color, world.dirty);
+    }
+    else if(world.band_renderer)
+    {
+        render_draw_list_banded(*world.band_renderer, buffer, world.draw_list, clear_color);
+    }
+    else
+    {
+        render_draw_list(buffer, world.draw_list, clear_color);
+    }
+}
+
+void world_render(World& world)
+{
+    uint32_t clear_color = world_color(world, PALETTE_BACKGROUND);
+    if(world.indexed)
+    {
+        world_render_into(world, &world.indexed_buffer, clear_color);
+    }
+    else
+    {
+        world_render_into(world, &world.buffer, clear_color);
+    }
+}
+
+void world_draw(World& world, double alpha)
+{
+    world_build_draw_list(world, alpha);
+    world_render(world);
+}
+
+void world_update_animations(World& world)
+{
+    animation_clock_advance(world.animation_clock);
+}
+
+void world_simulate_aliens(World& world)
+{
+    Game& game = world.game;
+    FormationTracker& tracker = world.formation_tracker;
+    size_t num_expired = aliens_update_death_timers(game.aliens, tracker.expired);
+
+    // Death sprites whose timer just ran out leave their row and column
+    for(size_t i = 0; i < num_expired; ++i)
+    {
+        uint32_t slot = tracker.expired[i];
+        --tracker.row_shown[slot / game.formation.cols];
+        --tracker.col_shown[slot % game.formation.cols];
+    }
+    if(num_expired) formation_shrink(game.formation, tracker);
+}
+
+void world_move_aliens(World& world)
+{
+    // The grid is in formation space, so nothing in it moves
+    update_aliens_position(world.game);
+}
+
+// Turns the live alien at entry ai into a death sprite
+static void kill_alien(World& world, size_t ai)
+{
+    Game& game = world.game;
+    AlienStore& aliens = game.aliens;
+    const SpriteAtlas& atlas = *world.atlas;
+    const PackedSprite& alien_sprite = alien_type_sprite(world, aliens.type[ai]);
+    uint32_t slot = aliens.slot[ai];
+
+    grid_remove(world.alien_grid, slot, aliens.x[ai], aliens.y[ai], alien_sprite.width, alien_sprite.height);
+    aliens.type[ai] = ALIEN_DEAD;
+    // NOTE: Hack to recenter death sprite
+    aliens.x[ai] -= (atlas.frames[SPRITE_ALIEN_DEATH].width - alien_sprite.width)/2;
+
+    // The death sprite stays in the formation's ranges until its timer runs out
+    formation_tracker_cover(
+        world.formation_tracker, slot / game.formation.cols, slot % game.formation.cols,
+        aliens.x[ai], aliens.y[ai], atlas.frames[SPRITE_ALIEN_DEATH]
+    );
+    aliens_kill(aliens, ai);
+}
+
+bool world_kill_alien(World& world, AlienHandle handle)
+{
+    size_t ai;
+    if(!alien_resolve(world.game.aliens, handle, ai) || ai >= world.game.aliens.num_live) return false;
+    kill_alien(world, ai);
+    return true;
+}
+
+// Tests a bullet against the aliens in the grid cells it covers and kills
+// the one with the lowest slot it overlaps. The order of slots within a
+// cell depends on the history of moves and removals, so picking by slot
+// keeps the outcome the same for a grid rebuilt from scratch.
+static bool bullet_hit_alien(World& world, size_t bi)
+{
+    Game& game = world.game;
+    AlienStore& aliens = game.aliens;
+    const SpriteAtlas& atlas = *world.atlas;
+    const uint8_t* type_frame = world.animation_clock.type_frame;
+    const PackedSprite& bullet_sprite = atlas.frames[SPRITE_BULLET];
+    // In formation space, like the grid and the alien positions
+    int16_t bullet_x = game.bullets.x[bi] - game.formation.offset_x;
+    int16_t bullet_y = game.bullets.y[bi] - game.formation.offset_y;
+
+    GridCellRange range;
+    if(!grid_cell_range(world.alien_grid, bullet_x, bullet_y, bullet_sprite.width, bullet_sprite.height, range))
+    {
+        return false;
+    }
+
+    size_t hit = aliens.count;
+    for(size_t row = range.row_begin; row < range.row_end; ++row)
+    {
+        for(size_t col = range.col_begin; col < range.col_end; ++col)
+        {
+            size_t count;
+            const uint32_t* cell = grid_cell(world.alien_grid, col, row, count);
+            for(size_t i = 0; i < count; ++i)
+            {
+                size_t slot = cell[i];
+                if(slot >= hit) continue;
+
+                size_t ai = aliens.slot_index[slot];
+                const PackedSprite& alien_sprite = atlas.frames[type_frame[aliens.type[ai]]];
+                bool overlap = sprite_overlap_check(
+                    bullet_sprite, bullet_x, bullet_y,
+                    alien_sprite, aliens.x[ai], aliens.y[ai]
+                );
+                if(overlap) hit = slot;
+            }
+        }
+    }
+
+    if(hit == aliens.count) return false;
+
+    kill_alien(world, aliens.slot_index[hit]);
+    return true;
+}
+
+void world_simulate_bullets(World& world)
+{
+    Game& game = world.game;
+    BulletStore& bullets = game.bullets;
+
+    bullets_advance(bullets);
+    bunkers_resolve_bullets(
+        game.bunkers, bullets,
+        world.atlas->frames[SPRITE_BULLET], world.atlas->frames[SPRITE_BUNKER_EXPLOSION],
+        world.bullet_scratch
+    );
+
+    // Bullets outside the formation's rectangle skip the grid altogether.
+    // Kills only add death sprites inside it, so it holds for the whole pass.
+    int formation_x = 0, formation_y = 0, formation_width = 0, formation_height = 0;
+    world_formation_rect(world, formation_x, formation_y, formation_width, formation_height);
+
+    const PackedSprite& bullet_sprite = world.atlas->frames[SPRITE_BULLET];
+    const int bullet_height = bullet_sprite.height;
+    for(size_t bi = 0; bi < bullets.count;)
+    {
+        bool in_formation =
+            bullets.x[bi] + (int)bullet_sprite.width > formation_x && bullets.x[bi] < formation_x + formation_width &&
+            bullets.y[bi] + bullet_height > formation_y && bullets.y[bi] < formation_y + formation_height;
+
+        if(bullets.y[bi] >= (int)game.height || bullets.y[bi] < bullet_height ||
+           (in_formation && bullet_hit_alien(world, bi)))
+        {
+            bullets_remove(bullets, bi);
+            continue;
+        }
+
+        ++bi;
+    }
+}
+
+void world_tick(World& world, const Input& input)
+{
+    world.prev_player_x = world.game.player.x;
+
+    {
+        PROFILE_SCOPE(PROFILE_ALIEN_SIM);
+        world_move_aliens(world);
+        world_update_animations(world);
+        world_simulate_aliens(world);
+    }
+
+    {
+        PROFILE_SCOPE(PROFILE_BULLET_SIM);
+        world_simulate_bullets(world);
+    }
+
+    {
+        PROFILE_SCOPE(PROFILE_INPUT);
+        simulate_player(world.game, *world.atlas, input.move_dir);
+        process_events(world.game, *world.atlas, input.fire_pressed);
+    }
+
+    ++world.game.tick;
+}
+
+void world_step(World& world, const Input& input)
+{
+    world_tick(world, input);
+    world_draw(world, 1.0);
+}
+
+uint64_t world_checksum(const World& world)
+{
+    // FNV-1a over the simulation state only, independent of rendering
+    uint64_t hash = 14695981039346656037ull;
+    const Game& game = world.game;
+    auto mix = [&hash](uint64_t value)
+    {
+        for(size_t i = 0; i < sizeof(value); ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    mix(game.tick);
+    mix(game.player.x);
+    mix(game.player.y);
+    for(size_t slot = 0; slot < game.aliens.count; ++slot)
+    {
+        // In slot order and at playfield positions, so the hash does not
+        // depend on where entries sit or how the formation splits them
+        size_t ai = game.aliens.slot_index[slot];
+        mix((int16_t)(game.formation.offset_x + game.aliens.x[ai]));
+        mix((int16_t)(game.formation.offset_y + game.aliens.y[ai]));
+        mix(game.aliens.type[ai]);
+        mix(game.aliens.death_timer[ai]);
+    }
+    for(size_t i = 0; i < game.bunkers.count; ++i)
+    {
+        const PackedSprite& mask = game.bunkers.masks[i];
+        for(size_t row = 0; row < mask.height; ++row) mix(mask.rows[row]);
+    }
+    mix(game.bullets.count);
+    for(size_t bi = 0; bi < game.bullets.count; ++bi)
+    {
+        mix(game.bullets.x[bi]);
+        mix(game.bullets.y[bi]);
+    }
+    for(size_t i = 0; i < NUM_OF_ALIEN_TYPES; ++i)
+    {
+        mix(world.animation_clock.time[i]);
+    }
+
+    return hash;
+}
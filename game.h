@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.h"
+#include "bunkers.h"
+#include "entities.h"
+#include "grid.h"
+#include "render.h"
+#include "sprite.h"
+#include "timestep.h"
+
+// Sizes of the classic game; GameConfig can override them per world
+constexpr size_t buffer_width = 600;
+constexpr size_t buffer_height = 400;
+constexpr size_t NUM_OF_ALIEN_ROWS = 6;
+constexpr size_t NUM_OF_ALIEN_TYPES = 3;
+constexpr size_t NUM_OF_ALIEN_COLS = 11;
+constexpr size_t NUM_OF_ALIENS = NUM_OF_ALIEN_ROWS * NUM_OF_ALIEN_COLS;
+constexpr size_t ALIEN_GRID_CELL_SIZE = 16;
+constexpr size_t NUM_OF_BUNKERS = 4;
+constexpr int16_t BUNKER_Y = 64;
+// Vertical distance between alien rows, and the gap left of the first column
+constexpr int16_t ALIEN_ROW_PITCH = 17;
+constexpr int16_t ALIEN_MARGIN_X = 10;
+// Largest playfield side; positions and the offsets added to them stay well
+// inside int16_t
+constexpr size_t GAME_MAX_DIMENSION = 16384;
+
+// Every sprite frame in the game, in atlas order. An alien type's frames
+// are consecutive.
+enum SpriteFrame: uint8_t
+{
+    SPRITE_ALIEN_A_0,
+    SPRITE_ALIEN_A_1,
+    SPRITE_ALIEN_B_0,
+    SPRITE_ALIEN_B_1,
+    SPRITE_ALIEN_C_0,
+    SPRITE_ALIEN_C_1,
+    SPRITE_ALIEN_DEATH,
+    SPRITE_PLAYER,
+    SPRITE_BULLET,
+    SPRITE_BUNKER,
+    // What a bullet clears out of a bunker
+    SPRITE_BUNKER_EXPLOSION,
+    NUM_SPRITE_FRAMES
+};
+
+// Palette entries the game draws with
+enum PaletteColor: uint8_t
+{
+    PALETTE_BACKGROUND,
+    PALETTE_SPRITE,
+    NUM_PALETTE_COLORS
+};
+
+// All frames back to back in one block, indexed by SpriteFrame
+struct SpriteAtlas
+{
+    PackedSprite frames[NUM_SPRITE_FRAMES];
+};
+
+// num_frames atlas frames from first_frame, each shown frame_duration ticks
+struct AlienAnimation
+{
+    uint8_t first_frame;
+    uint8_t num_frames;
+    uint8_t frame_duration;
+};
+
+// Animation time per alien type, and the atlas frame each AlienType shows
+// this tick. Resolved once per tick so draw and collision loops only index
+// type_frame; ALIEN_DEAD maps to the death sprite.
+struct AnimationClock
+{
+    size_t time[NUM_OF_ALIEN_TYPES];
+    uint8_t type_frame[NUM_OF_ALIEN_TYPES + 1];
+};
+
+struct Player
+{
+    size_t x, y;
+    size_t life;
+};
+
+// The aliens move as one rigid grid of slots, numbered in row-major order
+// with columns running left to right and rows bottom to top; each alien
+// keeps its slot for the level. Alien positions are local to the
+// formation and offset places it on the playfield, so a step or a drop is
+// one add whatever the alien count. The slot ranges are half-open and
+// cover every alien still drawn, alive or showing its death sprite.
+struct Formation
+{
+    int16_t offset_x, offset_y;
+    size_t rows, cols;
+    size_t row_begin, row_end;
+    size_t col_begin, col_end;
+};
+
+struct Game
+{
+    size_t width, height;
+    uint64_t tick;
+    uint64_t last_alien_drop_tick;
+    Formation formation;
+    AlienStore aliens;
+    BulletStore bullets;
+    BunkerField bunkers;
+    Player player;
+};
+
+// Sizes a world is built with and keeps for its lifetime. Every array
+// they scale is carved from the world's arena, sized from them up front.
+// Alien columns are spaced evenly across the width; the rows start as low
+// as in the classic layout, or lower if that would leave the top row off
+// the field.
+struct GameConfig
+{
+    // Of the playfield and the framebuffer
+    size_t width, height;
+    size_t alien_rows, alien_cols;
+    // Bullets in flight at once; the store starts at GAME_MAX_BULLETS and
+    // doubles up to this as fire demands
+    size_t max_bullets;
+};
+
+constexpr GameConfig DEFAULT_GAME_CONFIG = {
+    buffer_width, buffer_height, NUM_OF_ALIEN_ROWS, NUM_OF_ALIEN_COLS, GAME_MAX_BULLETS
+};
+
+// Input sampled for one simulation tick
+struct Input
+{
+    int move_dir;
+    bool fire_pressed;
+};
+
+// What keeps game.formation's slot ranges current as aliens die. All of it
+// follows from the alien arrays, so it is rebuilt after a load rather than
+// saved.
+struct FormationTracker
+{
+    // Aliens still drawn in each row and column
+    uint32_t* row_shown;
+    uint32_t* col_shown;
+    // Local pixel extent of everything drawn in each row and column so
+    // far; it only grows, and empty rows and columns fall out of the ranges
+    int16_t* row_bottom;
+    int16_t* row_top;
+    int16_t* col_left;
+    int16_t* col_right;
+    // Slots whose death sprite went away this tick
+    uint32_t* expired;
+};
+
+// Bytes formation_tracker_init takes from an arena
+constexpr size_t formation_tracker_bytes(size_t rows, size_t cols, size_t num_aliens)
+{
+    return arena_size_for((rows + cols) * sizeof(uint32_t)) +
+           arena_size_for(2 * (rows + cols) * sizeof(int16_t)) +
+           arena_size_for(num_aliens * sizeof(uint32_t));
+}
+
+bool formation_tracker_init(FormationTracker& tracker, size_t rows, size_t cols, size_t num_aliens, Arena& arena);
+
+// Moves every alien at once
+void formation_step(Formation& formation, int dx, int dy);
+
+// Baked at compile time from the ASCII art in game.cpp; read-only
+extern const SpriteAtlas game_atlas;
+extern const AlienAnimation alien_animations[NUM_OF_ALIEN_TYPES];
+
+// Everything a tick touches, so the loop can run with or without a window.
+// The buffer lives at the front of the arena for the whole session; the
+// game's alien and bullet arrays follow level_mark and are rebuilt in place
+// by world_restart.
+struct World
+{
+    Arena arena;
+    size_t level_mark;
+    GameConfig config;
+    Game game;
+    // Not owned; game_atlas unless a caller swaps in its own
+    const SpriteAtlas* atlas;
+    AnimationClock animation_clock;
+    // Holds alien slots at their formation-local positions, so the
+    // formation moves without re-binning anything
+    SpatialGrid alien_grid;
+    FormationTracker formation_tracker;
+    // Room for one entry per bullet, for passes that batch over them
+    uint32_t* bullet_scratch;
+    // Handle generation the next level's aliens start at
+    uint32_t next_alien_generation;
+    size_t prev_player_x;
+    Buffer buffer;
+    // Rendered into instead of buffer when indexed is set; the window
+    // expands it through palette on the GPU
+    IndexedBuffer indexed_buffer;
+    bool indexed;
+    uint32_t palette[PALETTE_SIZE];
+    DrawList draw_list;
+    // The bunker masks as of the last draw list build. Draw commands point
+    // here rather than into the game, whose copy may belong to a snapshot
+    // the simulation is already overwriting.
+    PackedSprite bunker_sprites[GAME_MAX_BUNKERS];
+    // Decides which parts of the buffer world_render redraws; its rects are
+    // also what the caller needs to upload afterwards
+    DirtyTracker dirty;
+    // Optional, not owned; when NULL world_draw renders on the calling thread
+    BandRenderer* band_renderer;
+};
+
+void animation_clock_init(AnimationClock& clock);
+void animation_clock_advance(AnimationClock& clock);
+
+void init_aliens(Game& game, const SpriteAtlas& atlas);
+void init_bunkers(Game& game, const SpriteAtlas& atlas);
+bool prepare_game(Game& game, const GameConfig& config, Arena& arena, uint32_t alien_generation = 0);
+
+// True if config lays out: sides up to GAME_MAX_DIMENSION, the formation's
+// columns across the width without overlap, its rows between the bunkers
+// and the top, and the bunkers apart. Says what is wrong on stderr if not.
+bool game_config_valid(const GameConfig& config);
+bool game_config_equal(const GameConfig& a, const GameConfig& b);
+
+// Returns how many pixels the formation dropped this tick
+size_t update_aliens_position(Game& game);
+void process_events(Game& game, const SpriteAtlas& atlas, bool fire_pressed);
+void simulate_player(Game& game, const SpriteAtlas& atlas, int move_dir);
+
+// Without a framebuffer world.buffer and world.indexed_buffer stay empty
+// and the world must not be rendered; it only ticks. Returns false, with
+// nothing left to destroy, if config is not valid or the level does not
+// fit in the arena.
+bool world_init(World& world, bool framebuffer = true, const GameConfig& config = DEFAULT_GAME_CONFIG);
+void world_destroy(World& world);
+
+// Starts the level over. Resets the arena to level_mark and rebuilds the
+// game in the same memory, so it does no heap allocation. Returns false if
+// the level no longer fits, leaving the world unplayable.
+bool world_restart(World& world);
+
+// Refills the alien grid and the formation tracker from the alien arrays,
+// after they were replaced wholesale
+void world_rebuild_alien_index(World& world);
+
+// Kills an alien outside of bullet collision, as a hit would. Returns
+// false if the handle no longer names a live alien.
+bool world_kill_alien(World& world, AlienHandle handle);
+
+// Playfield rectangle around every alien still drawn, in O(1) from the
+// formation's slot ranges. Returns false once none are left.
+bool world_formation_rect(const World& world, int& x, int& y, int& width, int& height);
+
+// Phases of one simulation tick, in the order world_tick runs them
+void world_move_aliens(World& world);
+void world_update_animations(World& world);
+void world_simulate_aliens(World& world);
+void world_simulate_bullets(World& world);
+void world_tick(World& world, const Input& input);
+
+// Switches between drawing colours into world.buffer and palette indices
+// into world.indexed_buffer. The next render redraws everything.
+void world_set_indexed(World& world, bool indexed);
+
+// What draw commands and clears use for a palette entry: the index in
+// indexed mode, its colour otherwise. Palette edits show up on the next
+// draw either way.
+uint32_t world_color(const World& world, PaletteColor color);
+
+// Collects a game state into world.draw_list; the world only supplies the
+// atlas. alpha in [0, 1] blends from the previous tick's positions for
+// smooth motion on displays faster than the tick rate.
+void build_draw_list(
+    World& world, const Game& game, const AnimationClock& animation_clock,
+    size_t prev_player_x, double alpha
+);
+void world_build_draw_list(World& world, double alpha);
+
+// Renders world.draw_list into world.buffer or world.indexed_buffer,
+// redrawing only what changed since the last call while world.dirty allows it
+void world_render(World& world);
+
+// Builds the draw list from the world's own state and renders it
+void world_draw(World& world, double alpha);
+
+// One tick followed by a draw of the resulting state
+void world_step(World& world, const Input& input);
+
+// Hash of the simulation state, used to check runs are bit-identical
+uint64_t world_checksum(const World& world);
@@ -0,0 +1,127 @@
+#include "grid.h"
+
+#include <algorithm>
+#include <cstring>
+
+void grid_init(SpatialGrid& grid, size_t width, size_t height, size_t cell_size)
+{
+    grid.width = width;
+    grid.height = height;
+    grid.cell_size = cell_size;
+    grid.num_cols = (width + cell_size - 1) / cell_size;
+    grid.num_rows = (height + cell_size - 1) / cell_size;
+    grid.cell_capacity = 4;
+
+    size_t num_cells = grid.num_cols * grid.num_rows;
+    grid.cell_counts = new uint32_t[num_cells]();
+    grid.cell_entries = new uint32_t[num_cells * grid.cell_capacity];
+}
+
+void grid_destroy(SpatialGrid& grid)
+{
+    delete[] grid.cell_counts;
+    delete[] grid.cell_entries;
+    grid.cell_counts = NULL;
+    grid.cell_entries = NULL;
+}
+
+void grid_clear(SpatialGrid& grid)
+{
+    memset(grid.cell_counts, 0, grid.num_cols * grid.num_rows * sizeof(uint32_t));
+}
+
+bool grid_cell_range(const SpatialGrid& grid, size_t x, size_t y, size_t w, size_t h, GridCellRange& range)
+{
+    ptrdiff_t left = (ptrdiff_t)x;
+    ptrdiff_t bottom = (ptrdiff_t)y;
+    ptrdiff_t right = left + (ptrdiff_t)w;
+    ptrdiff_t top = bottom + (ptrdiff_t)h;
+
+    if(w == 0 || h == 0 || right <= 0 || top <= 0 ||
+       left >= (ptrdiff_t)grid.width || bottom >= (ptrdiff_t)grid.height)
+    {
+        return false;
+    }
+
+    left = std::max<ptrdiff_t>(left, 0);
+    bottom = std::max<ptrdiff_t>(bottom, 0);
+    right = std::min<ptrdiff_t>(right, grid.width);
+    top = std::min<ptrdiff_t>(top, grid.height);
+
+    range.col_begin = left / grid.cell_size;
+    range.col_end = (right - 1) / grid.cell_size + 1;
+    range.row_begin = bottom / grid.cell_size;
+    range.row_end = (top - 1) / grid.cell_size + 1;
+
+    return true;
+}
+
+static void grid_grow(SpatialGrid& grid)
+{
+    size_t num_cells = grid.num_cols * grid.num_rows;
+    size_t capacity = 2 * grid.cell_capacity;
+    uint32_t* entries = new uint32_t[num_cells * capacity];
+
+    for(size_t cell = 0; cell < num_cells; ++cell)
+    {
+        memcpy(
+            entries + cell * capacity,
+            grid.cell_entries + cell * grid.cell_capacity,
+            grid.cell_counts[cell] * sizeof(uint32_t)
+        );
+    }
+
+    delete[] grid.cell_entries;
+    grid.cell_entries = entries;
+    grid.cell_capacity = capacity;
+}
+
+static void grid_insert_range(SpatialGrid& grid, uint32_t id, const GridCellRange& range)
+{
+    for(size_t row = range.row_begin; row < range.row_end; ++row)
+    {
+        for(size_t col = range.col_begin; col < range.col_end; ++col)
+        {
+            size_t cell = row * grid.num_cols + col;
+            if(grid.cell_counts[cell] == grid.cell_capacity) grid_grow(grid);
+
+            grid.cell_entries[cell * grid.cell_capacity + grid.cell_counts[cell]] = id;
+            ++grid.cell_counts[cell];
+        }
+    }
+}
+
+static void grid_remove_range(SpatialGrid& grid, uint32_t id, const GridCellRange& range)
+{
+    for(size_t row = range.row_begin; row < range.row_end; ++row)
+    {
+        for(size_t col = range.col_begin; col < range.col_end; ++col)
+        {
+            size_t cell = row * grid.num_cols + col;
+            uint32_t* entries = grid.cell_entries + cell * grid.cell_capacity;
+            uint32_t& count = grid.cell_counts[cell];
+
+            for(size_t i = 0; i < count; ++i)
+            {
+                if(entries[i] == id)
+                {
+                    entries[i] = entries[count - 1];
+                    --count;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void grid_insert(SpatialGrid& grid, uint32_t id, size_t x, size_t y, size_t w, size_t h)
+{
+    GridCellRange range;
+    if(grid_cell_range(grid, x, y, w, h, range)) grid_insert_range(grid, id, range);
+}
+
+void grid_remove(SpatialGrid& grid, uint32_t id, size_t x, size_t y, size_t w, size_t h)
+{
+    GridCellRange range;
+    if(grid_cell_range(grid, x, y, w, h, range)) grid_remove_range(grid, id, range);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Uniform grid over the playfield for broadphase collision. Every entry is
+// stored in each cell its rectangle touches, so a query only has to look at
+// the cells under the query rectangle. Entries are ids chosen by the caller.
+struct SpatialGrid
+{
+    size_t width, height;
+    size_t cell_size;
+    size_t num_cols, num_rows;
+    size_t cell_capacity;
+    uint32_t* cell_counts;
+    uint32_t* cell_entries;
+};
+
+// Cells covered by a rectangle, as half-open column and row ranges
+struct GridCellRange
+{
+    size_t col_begin, col_end;
+    size_t row_begin, row_end;
+};
+
+void grid_init(SpatialGrid& grid, size_t width, size_t height, size_t cell_size);
+void grid_destroy(SpatialGrid& grid);
+void grid_clear(SpatialGrid& grid);
+
+// Rectangles use the game's size_t coordinates; positions that wrapped
+// below zero are treated as negative and clipped to the grid.
+// Returns false if the rectangle is entirely outside the grid.
+bool grid_cell_range(const SpatialGrid& grid, size_t x, size_t y, size_t w, size_t h, GridCellRange& range);
+
+void grid_insert(SpatialGrid& grid, uint32_t id, size_t x, size_t y, size_t w, size_t h);
+void grid_remove(SpatialGrid& grid, uint32_t id, size_t x, size_t y, size_t w, size_t h);
+
+inline const uint32_t* grid_cell(const SpatialGrid& grid, size_t col, size_t row, size_t& count)
+{
+    size_t cell = row * grid.num_cols + col;
+    count = grid.cell_counts[cell];
+    return grid.cell_entries + cell * grid.cell_capacity;
+}
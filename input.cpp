@@ -0,0 +1,121 @@
+#include "input.h"
+#include "profiler.h"
+
+void input_queue_init(InputQueue& queue)
+{
+    queue.head.store(0, std::memory_order_relaxed);
+    queue.tail.store(0, std::memory_order_relaxed);
+    queue.dropped = 0;
+}
+
+bool input_queue_push(InputQueue& queue, const InputEvent& event)
+{
+    uint32_t head = queue.head.load(std::memory_order_relaxed);
+    if(head - queue.tail.load(std::memory_order_acquire) == INPUT_QUEUE_CAPACITY)
+    {
+        ++queue.dropped;
+        return false;
+    }
+
+    queue.events[head % INPUT_QUEUE_CAPACITY] = event;
+    queue.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool input_queue_peek(InputQueue& queue, InputEvent& event)
+{
+    uint32_t tail = queue.tail.load(std::memory_order_relaxed);
+    if(tail == queue.head.load(std::memory_order_acquire)) return false;
+
+    event = queue.events[tail % INPUT_QUEUE_CAPACITY];
+    return true;
+}
+
+bool input_queue_pop(InputQueue& queue, InputEvent& event)
+{
+    if(!input_queue_peek(queue, event)) return false;
+
+    queue.tail.store(queue.tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+}
+
+void input_state_init(InputState& state)
+{
+    state = {};
+}
+
+static void forward(InputQueue* consumed, InputEvent event, uint64_t tick)
+{
+    if(!consumed) return;
+    event.tick = tick;
+    input_queue_push(*consumed, event);
+}
+
+Input input_state_drain(InputState& state, InputQueue& queue, InputQueue* consumed, uint64_t tick)
+{
+    InputEvent event;
+    while(input_queue_pop(queue, event))
+    {
+        switch(event.type)
+        {
+        case INPUT_LEFT_PRESS:
+            state.left_held = state.left_tapped = true;
+            break;
+        case INPUT_LEFT_RELEASE:
+            state.left_held = false;
+            break;
+        case INPUT_RIGHT_PRESS:
+            state.right_held = state.right_tapped = true;
+            break;
+        case INPUT_RIGHT_RELEASE:
+            state.right_held = false;
+            break;
+        case INPUT_REWIND_PRESS:
+            state.rewind_held = true;
+            break;
+        case INPUT_REWIND_RELEASE:
+            state.rewind_held = false;
+            break;
+        case INPUT_FIRE:
+            if(state.num_pending_fires == INPUT_MAX_PENDING_FIRES)
+            {
+                ++state.dropped_fires;
+                continue;
+            }
+            state.pending_fire_ns[state.num_pending_fires++] = event.time_ns;
+            // Forwarded when it is applied
+            continue;
+        }
+
+        forward(consumed, event, tick);
+    }
+
+    Input input;
+    input.move_dir = (state.right_held || state.right_tapped) - (state.left_held || state.left_tapped);
+    state.left_tapped = state.right_tapped = false;
+
+    input.fire_pressed = state.num_pending_fires > 0;
+    if(input.fire_pressed)
+    {
+        InputEvent fire = {state.pending_fire_ns[0], 0, INPUT_FIRE};
+        forward(consumed, fire, tick);
+
+        --state.num_pending_fires;
+        for(size_t i = 0; i < state.num_pending_fires; ++i)
+        {
+            state.pending_fire_ns[i] = state.pending_fire_ns[i + 1];
+        }
+    }
+
+    return input;
+}
+
+void input_latency_record(InputQueue& consumed, uint64_t shown_tick, uint64_t shown_ns)
+{
+    InputEvent event;
+    while(input_queue_peek(consumed, event) && event.tick < shown_tick)
+    {
+        profiler_record(PROFILE_INPUT_LATENCY, event.time_ns, shown_ns);
+        input_queue_pop(consumed, event);
+    }
+}
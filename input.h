@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "game.h"
+
+enum InputEventType: uint8_t
+{
+    INPUT_LEFT_PRESS,
+    INPUT_LEFT_RELEASE,
+    INPUT_RIGHT_PRESS,
+    INPUT_RIGHT_RELEASE,
+    INPUT_FIRE,
+    // Steps the session backwards while held, where that is supported
+    INPUT_REWIND_PRESS,
+    INPUT_REWIND_RELEASE
+};
+
+struct InputEvent
+{
+    // monotonic_time_ns when the key event was seen
+    uint64_t time_ns;
+    // Tick that applied the event, set once the simulation consumes it
+    uint64_t tick;
+    InputEventType type;
+};
+
+constexpr size_t INPUT_QUEUE_CAPACITY = 256;
+constexpr size_t INPUT_MAX_PENDING_FIRES = 16;
+
+// Single-producer single-consumer ring of events. The producer only writes
+// head and the consumer only writes tail; each sits on its own cache line.
+// Neither side blocks: a push into a full queue fails and is counted.
+struct InputQueue
+{
+    std::atomic<uint32_t> head;
+    char head_padding[64 - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> tail;
+    char tail_padding[64 - sizeof(std::atomic<uint32_t>)];
+    // Written by the producer only
+    uint32_t dropped;
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+};
+
+void input_queue_init(InputQueue& queue);
+
+// Producer side
+bool input_queue_push(InputQueue& queue, const InputEvent& event);
+
+// Consumer side; peek leaves the event in the queue
+bool input_queue_peek(InputQueue& queue, InputEvent& event);
+bool input_queue_pop(InputQueue& queue, InputEvent& event);
+
+// Key state as the simulation has seen it so far
+struct InputState
+{
+    bool left_held, right_held;
+    // Pressed and released again before any tick saw the key held
+    bool left_tapped, right_tapped;
+    bool rewind_held;
+    // Fire presses not applied yet, oldest first, by event time
+    uint64_t pending_fire_ns[INPUT_MAX_PENDING_FIRES];
+    size_t num_pending_fires;
+    // Presses beyond INPUT_MAX_PENDING_FIRES
+    size_t dropped_fires;
+};
+
+void input_state_init(InputState& state);
+
+// Drains every queued event into state and returns the input for tick, the
+// value of game.tick before the tick runs. A tap shorter than a tick still
+// moves the player for one tick. One fire press is applied per tick and the
+// rest wait for the following ticks, so presses between ticks are not lost.
+// Each event, once applied, is stamped with tick and pushed to consumed if
+// it is given.
+Input input_state_drain(InputState& state, InputQueue& queue, InputQueue* consumed, uint64_t tick);
+
+// Records key-to-photon latency into the profiler's input_latency zone for
+// every consumed event applied before shown_tick, the game.tick of the frame
+// that just reached the screen at shown_ns
+void input_latency_record(InputQueue& consumed, uint64_t shown_tick, uint64_t shown_ns);
@@ -1,19 +1,35 @@
 #include <cstddef>
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <ctime>
-#include <algorithm>
 
-bool game_running = false;
-int move_dir = 0;
-bool fire_pressed = 0;
+#include "capture.h"
+#include "game.h"
+#include "pipeline.h"
+#include "profiler.h"
+
+// How far back holding backspace can take the session
+constexpr size_t REWIND_SECONDS = 10;
+
+// Window-side session state, reached from the key callback through the
+// window's user pointer
+struct WindowSession
+{
+    bool running;
+    // Key events for the simulation thread, stamped as GLFW delivers them
+    InputQueue input_queue;
+};
+
+static void push_input(WindowSession& session, InputEventType type)
+{
+    InputEvent event = {monotonic_time_ns(), 0, type};
+    input_queue_push(session.input_queue, event);
+}
 
-constexpr size_t buffer_width = 600;
-constexpr size_t buffer_height = 400;
-constexpr size_t NUM_OF_ALIEN_ROWS = 6;
-constexpr size_t NUM_OF_ALIEN_TYPES = 3;
 #define GL_ERROR_CASE(glerror)\
     case glerror: snprintf(error, sizeof(error), "%s", #glerror)
 
@@ -70,319 +86,40 @@ void error_callback(int error, const char* description)
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods){
+    WindowSession& session = *(WindowSession*)glfwGetWindowUserPointer(window);
     switch(key){
     case GLFW_KEY_ESCAPE:
-        if(action == GLFW_PRESS) game_running = false;
+        if(action == GLFW_PRESS) session.running = false;
         break;
     case GLFW_KEY_RIGHT:
-        if(action == GLFW_PRESS) move_dir += 1;
-        else if(action == GLFW_RELEASE) move_dir -= 1;
+        if(action == GLFW_PRESS) push_input(session, INPUT_RIGHT_PRESS);
+        else if(action == GLFW_RELEASE) push_input(session, INPUT_RIGHT_RELEASE);
         break;
     case GLFW_KEY_LEFT:
-        if(action == GLFW_PRESS) move_dir -= 1;
-        else if(action == GLFW_RELEASE) move_dir += 1;
+        if(action == GLFW_PRESS) push_input(session, INPUT_LEFT_PRESS);
+        else if(action == GLFW_RELEASE) push_input(session, INPUT_LEFT_RELEASE);
         break;
     case GLFW_KEY_SPACE:
-        if(action == GLFW_RELEASE) fire_pressed = true;
+        if(action == GLFW_RELEASE) push_input(session, INPUT_FIRE);
+        break;
+    case GLFW_KEY_BACKSPACE:
+        if(action == GLFW_PRESS) push_input(session, INPUT_REWIND_PRESS);
+        else if(action == GLFW_RELEASE) push_input(session, INPUT_REWIND_RELEASE);
         break;
     default:
         break;
     }
 }
 
-struct Buffer
-{
-    size_t width, height;
-    uint32_t* data;
-};
-
-struct Sprite
-{
-    size_t width, height;
-    uint8_t* data;
-};
-
-struct Sprites{
-    Sprite alien_sprites[6];
-    Sprite alien_death_sprite;
-    Sprite player_sprite;
-    Sprite bullet_sprite;
-};
-
-struct Alien
-{
-    size_t x, y;
-    uint8_t type;
-};
-
-struct Bullet
-{
-    size_t x, y;
-    int dir;
-};
-
-struct Player
-{
-    size_t x, y;
-    size_t life;
-};
-
-constexpr int GAME_MAX_BULLETS = 128;
-
-struct Game
-{
-    size_t width, height;
-    size_t num_aliens;
-    size_t num_bullets;
-    Alien* aliens;
-    Player player;
-    Bullet bullets[GAME_MAX_BULLETS];
-};
-
-struct SpriteAnimation
-{
-    bool loop;
-    size_t num_frames;
-    size_t frame_duration;
-    size_t time;
-    Sprite** frames;
-};
-
-enum AlienType: uint8_t
-{
-    ALIEN_DEAD   = 0,
-    ALIEN_TYPE_A = 1,
-    ALIEN_TYPE_B = 2,
-    ALIEN_TYPE_C = 3
-};
-
 struct glParams{
     GLFWwindow* window;
     Buffer buffer;
     GLuint fullscreen_triangle_vao;
-
+    // Present indexed_buffer through the palette texture instead of buffer
+    bool indexed;
+    IndexedBuffer indexed_buffer;
+    GLuint palette_texture;
 };
-void buffer_clear(Buffer* buffer, uint32_t color)
-{
-    for(size_t i = 0; i < buffer->width * buffer->height; ++i)
-    {
-        buffer->data[i] = color;
-    }
-}
-
-bool sprite_overlap_check(
-    const Sprite& sp_a, size_t x_a, size_t y_a,
-    const Sprite& sp_b, size_t x_b, size_t y_b
-)
-{
-    if(x_a < x_b + sp_b.width && x_a + sp_a.width > x_b &&
-       y_a < y_b + sp_b.height && y_a + sp_a.height > y_b)
-    {
-        return true;
-    }
-
-    return false;
-}
-
-void buffer_draw_sprite(Buffer* buffer, const Sprite& sprite, size_t x, size_t y, uint32_t color)
-{
-    for(size_t xi = 0; xi < sprite.width; ++xi)
-    {
-        for(size_t yi = 0; yi < sprite.height; ++yi)
-        {
-            if(sprite.data[yi * sprite.width + xi] &&
-               (sprite.height - 1 + y - yi) < buffer->height &&
-               (x + xi) < buffer->width)
-            {
-                buffer->data[(sprite.height - 1 + y - yi) * buffer->width + (x + xi)] = color;
-            }
-        }
-    }
-}
-
-uint32_t rgb_to_uint32(uint8_t r, uint8_t g, uint8_t b)
-{
-    return (r << 24) | (g << 16) | (b << 8) | 255;
-}
-
-void update_aliens_position(Game& game)
-{
-    const int pixels_to_drop = 5;
-    const int min_delta_time = 3;
-    static std::time_t last_update_time = 0;
-    std::time_t delta_time = 0;
-
-    if(last_update_time == 0)
-    {
-        last_update_time = time(NULL);
-    }
-
-    delta_time = time(NULL) - last_update_time;
-
-    if(delta_time > min_delta_time) 
-    {
-        
-        last_update_time = time(NULL);
-        
-        for(size_t ai = 0; ai < game.num_aliens; ++ai)
-        {
-            game.aliens[ai].y -= pixels_to_drop;
-        }
-    }
-}
-
-void init_sprites(Sprites& sprites){
-
-    sprites.alien_sprites[0].width = 20;
-    sprites.alien_sprites[0].height = 8;
-    sprites.alien_sprites[0].data = new uint8_t[64]
-    {
-        0,0,0,1,1,0,0,0, // ...@@...
-        0,0,1,1,1,1,0,0, // ..@@@@..
-        0,1,1,1,1,1,1,0, // .@@@@@@.
-        1,1,0,1,1,0,1,1, // @@.@@.@@
-        1,1,1,1,1,1,1,1, // @@@@@@@@
-        0,1,0,1,1,0,1,0, // .@.@@.@.
-        1,0,0,0,0,0,0,1, // @......@
-        0,1,0,0,0,0,1,0  // .@....@.
-    };
-    
-    sprites.alien_sprites[1].width = 8;
-    sprites.alien_sprites[1].height = 8;
-    sprites.alien_sprites[1].data = new uint8_t[64]
-    {
-        0,0,0,1,1,0,0,0, // ...@@...
-        0,0,1,1,1,1,0,0, // ..@@@@..
-        0,1,1,1,1,1,1,0, // .@@@@@@.
-        1,1,0,1,1,0,1,1, // @@.@@.@@
-        1,1,1,1,1,1,1,1, // @@@@@@@@
-        0,0,1,0,0,1,0,0, // ..@..@..
-        0,1,0,1,1,0,1,0, // .@.@@.@.
-        1,0,1,0,0,1,0,1  // @.@..@.@
-    };
-    
-    sprites.alien_sprites[2].width = 11;
-    sprites.alien_sprites[2].height = 8;
-    sprites.alien_sprites[2].data = new uint8_t[88]
-    {
-        0,0,1,0,0,0,0,0,1,0,0, // ..@.....@..
-        0,0,0,1,0,0,0,1,0,0,0, // ...@...@...
-        0,0,1,1,1,1,1,1,1,0,0, // ..@@@@@@@..
-        0,1,1,0,1,1,1,0,1,1,0, // .@@.@@@.@@.
-        1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@
-        1,0,1,1,1,1,1,1,1,0,1, // @.@@@@@@@.@
-        1,0,1,0,0,0,0,0,1,0,1, // @.@.....@.@
-        0,0,0,1,1,0,1,1,0,0,0  // ...@@.@@...
-    };
-    
-    sprites.alien_sprites[3].width = 11;
-    sprites.alien_sprites[3].height = 8;
-    sprites.alien_sprites[3].data = new uint8_t[88]
-    {
-        0,0,1,0,0,0,0,0,1,0,0, // ..@.....@..
-        1,0,0,1,0,0,0,1,0,0,1, // @..@...@..@
-        1,0,1,1,1,1,1,1,1,0,1, // @.@@@@@@@.@
-        1,1,1,0,1,1,1,0,1,1,1, // @@@.@@@.@@@
-        1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@
-        0,1,1,1,1,1,1,1,1,1,0, // .@@@@@@@@@.
-        0,0,1,0,0,0,0,0,1,0,0, // ..@.....@..
-        0,1,0,0,0,0,0,0,0,1,0  // .@.......@.
-    };
-    
-    sprites.alien_sprites[4].width = 12;
-    sprites.alien_sprites[4].height = 8;
-    sprites.alien_sprites[4].data = new uint8_t[96]
-    {
-        0,0,0,0,1,1,1,1,0,0,0,0, // ....@@@@....
-        0,1,1,1,1,1,1,1,1,1,1,0, // .@@@@@@@@@@.
-        1,1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@@
-        1,1,1,0,0,1,1,0,0,1,1,1, // @@@..@@..@@@
-        1,1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@@
-        0,0,0,1,1,0,0,1,1,0,0,0, // ...@@..@@...
-        0,0,1,1,0,1,1,0,1,1,0,0, // ..@@.@@.@@..
-        1,1,0,0,0,0,0,0,0,0,1,1  // @@........@@
-    };
-    
-    
-    sprites.alien_sprites[5].width = 12;
-    sprites.alien_sprites[5].height = 8;
-    sprites.alien_sprites[5].data = new uint8_t[96]
-    {
-        0,0,0,0,1,1,1,1,0,0,0,0, // ....@@@@....
-        0,1,1,1,1,1,1,1,1,1,1,0, // .@@@@@@@@@@.
-        1,1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@@
-        1,1,1,0,0,1,1,0,0,1,1,1, // @@@..@@..@@@
-        1,1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@@
-        0,0,1,1,1,0,0,1,1,1,0,0, // ..@@@..@@@..
-        0,1,1,0,0,1,1,0,0,1,1,0, // .@@..@@..@@.
-        0,0,1,1,0,0,0,0,1,1,0,0  // ..@@....@@..
-    };
-    
-    sprites.alien_death_sprite.width = 13;
-    sprites.alien_death_sprite.height = 7;
-    sprites.alien_death_sprite.data = new uint8_t[91]
-    {
-        0,1,0,0,1,0,0,0,1,0,0,1,0, // .@..@...@..@.
-        0,0,1,0,0,1,0,1,0,0,1,0,0, // ..@..@.@..@..
-        0,0,0,1,0,0,0,0,0,1,0,0,0, // ...@.....@...
-        1,1,0,0,0,0,0,0,0,0,0,1,1, // @@.........@@
-        0,0,0,1,0,0,0,0,0,1,0,0,0, // ...@.....@...
-        0,0,1,0,0,1,0,1,0,0,1,0,0, // ..@..@.@..@..
-        0,1,0,0,1,0,0,0,1,0,0,1,0  // .@..@...@..@.
-    };
-    
-    sprites.player_sprite.width = 11;
-    sprites.player_sprite.height = 7;
-    sprites.player_sprite.data = new uint8_t[77]
-    {
-        0,0,0,0,0,1,0,0,0,0,0, // .....@.....
-        0,0,0,0,1,1,1,0,0,0,0, // ....@@@....
-        0,0,0,0,1,1,1,0,0,0,0, // ....@@@....
-        0,1,1,1,1,1,1,1,1,1,0, // .@@@@@@@@@.
-        1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@
-        1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@
-        1,1,1,1,1,1,1,1,1,1,1, // @@@@@@@@@@@
-    };
-    
-    sprites.bullet_sprite.width = 1;
-    sprites.bullet_sprite.height = 3;
-    sprites.bullet_sprite.data = new uint8_t[3]
-    {
-        1, // @
-        1, // @
-        1  // @
-    };
-}
-
-void init_aliens(Game& game, SpriteAnimation* alien_animation, Sprites& sprites)
-{
-    for(size_t i = 0; i < 3; ++i)
-    {
-        alien_animation[i].loop = true;
-        alien_animation[i].num_frames = 2;
-        alien_animation[i].frame_duration = 10;
-        alien_animation[i].time = 0;
-        
-        alien_animation[i].frames = new Sprite*[2];
-        alien_animation[i].frames[0] = &sprites.alien_sprites[2 * i];
-        alien_animation[i].frames[1] = &sprites.alien_sprites[2 * i + 1];
-    }
-
-    for(size_t yi = 0; yi < NUM_OF_ALIEN_ROWS; ++yi)
-    {
-        for(size_t xi = 0; xi < 11; ++xi)
-        {
-            Alien& alien = game.aliens[yi * 11 + xi];
-            alien.type = std::min((NUM_OF_ALIEN_ROWS - yi) / 2 + 1,NUM_OF_ALIEN_TYPES);
-
-            const Sprite& sprite = sprites.alien_sprites[2 * (alien.type - 1)];
-
-            alien.x = buffer_width / 11 * xi + 10 + (sprites.alien_death_sprite.width - sprite.width)/2;
-            alien.y = 17 * yi + 128;
-        }
-    }
-
-}
 
 int setup_gl(glParams& params){
 
@@ -442,12 +179,34 @@ int setup_gl(glParams& params){
     GLuint buffer_texture;
     glGenTextures(1, &buffer_texture);
     glBindTexture(GL_TEXTURE_2D, buffer_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, params.buffer.width, params.buffer.height, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, params.buffer.data);
+    if(params.indexed)
+    {
+        // Byte rows of indexed_buffer are not 4-aligned in general
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        memset(params.indexed_buffer.data, 0, params.indexed_buffer.width * params.indexed_buffer.height);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, params.indexed_buffer.width, params.indexed_buffer.height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, params.indexed_buffer.data);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, params.buffer.width, params.buffer.height, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, params.buffer.data);
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+    // PALETTE_SIZE x 1 colours on unit 1, looked up by index in the shader
+    if(params.indexed)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glGenTextures(1, &params.palette_texture);
+        glBindTexture(GL_TEXTURE_2D, params.palette_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, PALETTE_SIZE, 1, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
     // Create vao for generating fullscreen triangle
     glGenVertexArrays(1, &params.fullscreen_triangle_vao);
 
@@ -465,6 +224,22 @@ int setup_gl(glParams& params){
         "    outColor = texture(buffer, TexCoord).rgb;\n"
         "}\n";
 
+    // Integer textures cannot be filtered, so the index is fetched as is
+    static const char* indexed_fragment_shader =
+        "\n"
+        "#version 330\n"
+        "\n"
+        "uniform usampler2D buffer;\n"
+        "uniform sampler2D palette;\n"
+        "noperspective in vec2 TexCoord;\n"
+        "\n"
+        "out vec3 outColor;\n"
+        "\n"
+        "void main(void){\n"
+        "    uint index = texture(buffer, TexCoord).r;\n"
+        "    outColor = texelFetch(palette, ivec2(int(index), 0), 0).rgb;\n"
+        "}\n";
+
     static const char* vertex_shader =
         "\n"
         "#version 330\n"
@@ -497,9 +272,10 @@ int setup_gl(glParams& params){
         //Create fragment shader
         GLuint shader_fp = glCreateShader(GL_FRAGMENT_SHADER);
 
-        glShaderSource(shader_fp, 1, &fragment_shader, 0);
+        const char* source = params.indexed ? indexed_fragment_shader : fragment_shader;
+        glShaderSource(shader_fp, 1, &source, 0);
         glCompileShader(shader_fp);
-        validate_shader(shader_fp, fragment_shader);
+        validate_shader(shader_fp, source);
         glAttachShader(shader_id, shader_fp);
 
         glDeleteShader(shader_fp);
@@ -511,7 +287,6 @@ int setup_gl(glParams& params){
         fprintf(stderr, "Error while validating shader.\n");
         glfwTerminate();
         glDeleteVertexArrays(1, &params.fullscreen_triangle_vao);
-        delete[] params.buffer.data;
         return -1;
     }
 
@@ -519,6 +294,10 @@ int setup_gl(glParams& params){
 
     GLint location = glGetUniformLocation(shader_id, "buffer");
     glUniform1i(location, 0);
+    if(params.indexed)
+    {
+        glUniform1i(glGetUniformLocation(shader_id, "palette"), 1);
+    }
 
     //OpenGL setup
     glDisable(GL_DEPTH_TEST);
@@ -526,207 +305,372 @@ int setup_gl(glParams& params){
 
     glBindVertexArray(params.fullscreen_triangle_vao);
 
+    // Sub-rectangle uploads read rows at the buffer's full stride
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, params.buffer.width);
+
     return 0;
 }
 
-void prepare_game(Game& game)
+constexpr size_t NUM_UPLOAD_BUFFERS = 3;
+
+// Ring of pixel unpack buffers for streaming the frame to the texture.
+// Each frame's dirty rectangles are copied into the next buffer, which is
+// orphaned on map so the driver never waits on an upload still reading
+// it. glTexSubImage2D then sources from the buffer and returns without
+// copying, so the transfer overlaps the next frame. When the ring is off
+// the rectangles go up straight from client memory.
+struct UploadRing
+{
+    GLuint buffers[NUM_UPLOAD_BUFFERS];
+    size_t next;
+    size_t size;
+    bool enabled;
+    // Layout of the frame being streamed
+    size_t width;
+    size_t pixel_size;
+    GLenum format, type;
+};
+
+void upload_ring_init(
+    UploadRing& ring, size_t width, size_t height, size_t pixel_size,
+    GLenum format, GLenum type, bool enabled
+)
 {
-    game.width = buffer_width;
-    game.height = buffer_height;
-    game.num_bullets = 0;
-    game.num_aliens = NUM_OF_ALIEN_ROWS * 11;
-    game.aliens = new Alien[game.num_aliens];
-
-    game.player.x = buffer_width / 2 - 5;
-    game.player.y = 32;
-    game.player.life = 3;
+    ring = {};
+    ring.enabled = enabled;
+    ring.width = width;
+    ring.pixel_size = pixel_size;
+    ring.format = format;
+    ring.type = type;
+    ring.size = width * height * pixel_size;
+    if(!ring.enabled) return;
+
+    glGenBuffers(NUM_UPLOAD_BUFFERS, ring.buffers);
+    for(size_t i = 0; i < NUM_UPLOAD_BUFFERS; ++i)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffers[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, ring.size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl_debug(__FILE__, __LINE__);
 }
 
-void destory_all(glParams params, Sprites& sprites, SpriteAnimation* alien_animation, Game game, uint8_t* death_counters)
+void upload_ring_destroy(UploadRing& ring)
 {
-    glfwDestroyWindow(params.window);
-    glfwTerminate();
+    if(ring.enabled) glDeleteBuffers(NUM_UPLOAD_BUFFERS, ring.buffers);
+    ring = {};
+}
 
-    glDeleteVertexArrays(1, &params.fullscreen_triangle_vao);
+static void upload_rects_from(const UploadRing& ring, const uint8_t* base, const DirtyRect* rects, size_t num_rects)
+{
+    for(size_t i = 0; i < num_rects; ++i)
+    {
+        const DirtyRect& rect = rects[i];
+        glTexSubImage2D(
+            GL_TEXTURE_2D, 0, rect.x, rect.y,
+            rect.width, rect.height,
+            ring.format, ring.type,
+            base + (rect.y * ring.width + rect.x) * ring.pixel_size
+        );
+    }
+}
 
-    for(size_t i = 0; i < 6; ++i)
+// Uploads the given rectangles of pixels to the bound texture
+void upload_ring_upload(UploadRing& ring, const void* pixels, const DirtyRect* rects, size_t num_rects)
+{
+    const uint8_t* src = (const uint8_t*)pixels;
+    if(!ring.enabled)
     {
-        delete[] sprites.alien_sprites[i].data;
+        upload_rects_from(ring, src, rects, num_rects);
+        return;
     }
 
-    delete[] sprites.alien_death_sprite.data;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffers[ring.next]);
+    ring.next = (ring.next + 1) % NUM_UPLOAD_BUFFERS;
 
-    for(size_t i = 0; i < 3; ++i)
+    // The buffer keeps the frame's layout; only the dirty rows are written
+    uint8_t* mapped = (uint8_t*)glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, ring.size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+    );
+    if(mapped)
     {
-        delete[] alien_animation[i].frames;
+        size_t stride = ring.width * ring.pixel_size;
+        for(size_t i = 0; i < num_rects; ++i)
+        {
+            const DirtyRect& rect = rects[i];
+            size_t offset = (rect.y * ring.width + rect.x) * ring.pixel_size;
+            for(size_t row = 0; row < rect.height; ++row, offset += stride)
+            {
+                memcpy(mapped + offset, src + offset, rect.width * ring.pixel_size);
+            }
+        }
+    }
+
+    // Unmap fails if the storage was lost while mapped
+    if(mapped && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+    {
+        // Offsets into the bound buffer, not client pointers
+        upload_rects_from(ring, NULL, rects, num_rects);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        upload_rects_from(ring, src, rects, num_rects);
     }
-    delete[] params.buffer.data;
-    delete[] game.aliens;
-    delete[] death_counters;
 }
 
-void process_events(Game& game, Sprites& sprites)
+// Reads the texture back and compares it with the frame that was uploaded
+bool texture_matches_buffer(const glParams& params)
 {
-    if(fire_pressed && game.num_bullets < GAME_MAX_BULLETS)
+    if(params.indexed)
     {
-        game.bullets[game.num_bullets].x = game.player.x + sprites.player_sprite.width / 2;
-        game.bullets[game.num_bullets].y = game.player.y + sprites.player_sprite.height;
-        game.bullets[game.num_bullets].dir = 2;
-        ++game.num_bullets;
+        const IndexedBuffer& buffer = params.indexed_buffer;
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        uint8_t* pixels = new uint8_t[buffer.width * buffer.height];
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, pixels);
+        bool match = memcmp(pixels, buffer.data, buffer.width * buffer.height) == 0;
+        delete[] pixels;
+        return match;
     }
-    fire_pressed = false;
+
+    const Buffer& buffer = params.buffer;
+    uint32_t* pixels = new uint32_t[buffer.width * buffer.height];
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, pixels);
+    bool match = memcmp(pixels, buffer.data, buffer.width * buffer.height * sizeof(uint32_t)) == 0;
+    delete[] pixels;
+    return match;
 }
 
-void simulate_player(Game& game, Sprites& sprites)
+void destory_all(glParams params)
 {
-    int player_move_dir = 2 * move_dir;
+    glfwDestroyWindow(params.window);
+    glfwTerminate();
 
-    if(player_move_dir != 0)
-    {
-        if(game.player.x + sprites.player_sprite.width + player_move_dir >= game.width)
-        {
-            game.player.x = game.width - sprites.player_sprite.width;
-        }
-        else if((int)game.player.x + player_move_dir <= 0)
-        {
-            game.player.x = 0;
-        }
-        else game.player.x += player_move_dir;
-    }
+    glDeleteVertexArrays(1, &params.fullscreen_triangle_vao);
 }
+
 int main(int argc, char* argv[])
 {
+    // --record <path> logs every tick's input for replay with ./bench
+    // --trace <path> dumps the last profiler samples as a Chrome trace
+    // --no-pbo uploads from client memory instead of the buffer ring
+    // --indexed draws palette indices and expands them in the shader
+    // Holding backspace rewinds up to REWIND_SECONDS, except with --record
+    // --capture <path> writes frames on a background thread: one PNG per
+    //   frame for a printf pattern ending in .png, else a frame stream that
+    //   ./bench --verify-capture can read; --capture-every <n> thins them
+    // --frames <n> quits after n frames and checks the texture against the
+    //   buffer, e.g. on llvmpipe with no GPU:
+    //   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./main --frames 600
+    const char* record_path = NULL;
+    const char* trace_path = NULL;
+    bool use_pbo = true;
+    bool indexed = false;
+    size_t max_frames = 0;
+    const char* capture_path = NULL;
+    size_t capture_every = 1;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if(strcmp(argv[i], "--no-pbo") == 0) use_pbo = false;
+        else if(strcmp(argv[i], "--indexed") == 0) indexed = true;
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) max_frames = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture_path = argv[++i];
+        else if(strcmp(argv[i], "--capture-every") == 0 && i + 1 < argc) capture_every = strtoul(argv[++i], NULL, 10);
+    }
+
     glParams params = {}; 
-    Game game = {};
-    Sprites sprites = {};
-    SpriteAnimation alien_animation[NUM_OF_ALIEN_ROWS - 1] {};
-    uint32_t clear_color = rgb_to_uint32(0, 128, 0);
-
-    params.buffer.width  = buffer_width;
-    params.buffer.height = buffer_height;
-    params.buffer.data   = new uint32_t[params.buffer.width * params.buffer.height];
+    World world = {};
+    BandRenderer band_renderer;
+
+    if(!world_init(world))
+    {
+        fprintf(stderr, "Error: could not build the world.\n");
+        return -1;
+    }
+    world_set_indexed(world, indexed);
+    params.buffer = world.buffer;
+    params.indexed = indexed;
+    params.indexed_buffer = world.indexed_buffer;
     
     if (setup_gl(params) != 0 ){
+        world_destroy(world);
         return -1;
     }
-    
-    prepare_game(game);
-    init_sprites(sprites);
-    init_aliens(game, alien_animation, sprites);
 
-    uint8_t* death_counters = new uint8_t[game.num_aliens];
-    for(size_t i = 0; i < game.num_aliens; ++i)
+    UploadRing upload_ring;
+    if(params.indexed)
     {
-        death_counters[i] = 10;
+        upload_ring_init(
+            upload_ring, params.indexed_buffer.width, params.indexed_buffer.height, sizeof(uint8_t),
+            GL_RED_INTEGER, GL_UNSIGNED_BYTE, use_pbo
+        );
+    }
+    else
+    {
+        upload_ring_init(
+            upload_ring, params.buffer.width, params.buffer.height, sizeof(uint32_t),
+            GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, use_pbo
+        );
+    }
+
+    band_renderer_init(band_renderer, 0, 0);
+    if(thread_pool_size(band_renderer.pool) > 1)
+    {
+        world.band_renderer = &band_renderer;
     }
     
-    game_running = true;
-    while (!glfwWindowShouldClose(params.window) && game_running)
+    // Simulation runs on its own thread; this thread only draws and
+    // presents the newest snapshot it publishes
+    SnapshotTripleBuffer snapshots;
+    triple_buffer_init(snapshots, world.game.aliens.count, world.game.bullets.max_count);
+
+    InputRecording recording;
+    input_recording_init(recording, world.config);
+
+    // Applied events come back from the simulation so their latency can be
+    // measured once the frame showing them is presented
+    static InputQueue consumed_events;
+    static WindowSession session;
+    input_queue_init(session.input_queue);
+    input_queue_init(consumed_events);
+    glfwSetWindowUserPointer(params.window, &session);
+
+    SnapshotRing history;
+    snapshot_ring_init(history, world.game.aliens.count, world.game.bullets.max_count, REWIND_SECONDS * SIM_TICKS_PER_SECOND, 0);
+
+    // Copies go to a writer thread, so a slow disk drops frames rather
+    // than stalling the render loop
+    FrameCapture capture;
+    bool capturing = false;
+    if(capture_path)
     {
-        buffer_clear(&params.buffer, clear_color);
-        update_aliens_position(game);
-        
-        // Draw
-        for(size_t ai = 0; ai < game.num_aliens; ++ai)
+        size_t length = strlen(capture_path);
+        CaptureFormat format = length >= 4 && strcmp(capture_path + length - 4, ".png") == 0
+            ? CAPTURE_FORMAT_PNG : CAPTURE_FORMAT_STREAM;
+        capturing = frame_capture_start(
+            capture, world.buffer.width, world.buffer.height,
+            format, capture_path, capture_every, 8
+        );
+    }
+
+    SimThread sim;
+    sim_thread_start(
+        sim, &world, &snapshots, &session.input_queue, &consumed_events,
+        record_path ? &recording : NULL, record_path ? NULL : &history
+    );
+
+    FrameStats render_stats = {};
+    uint64_t last_frame_ns = monotonic_time_ns();
+
+    session.running = true;
+    while (!glfwWindowShouldClose(params.window) && session.running)
+    {
+        const GameSnapshot* snapshot = triple_buffer_acquire(snapshots);
+        if(snapshot)
         {
-            if(!death_counters[ai]) continue;
+            double alpha = (double)(monotonic_time_ns() - snapshot->publish_time_ns) / SIM_TICK_NS;
+            world_draw_snapshot(world, *snapshot, std::min(alpha, 1.0));
 
-            const Alien& alien = game.aliens[ai];
-            if(alien.type == ALIEN_DEAD)
+            if(capturing && world.indexed)
+            {
+                frame_capture_push(capture, world.indexed_buffer, world.palette, snapshot->game.tick);
+            }
+            else if(capturing)
             {
-                buffer_draw_sprite(&params.buffer, sprites.alien_death_sprite, alien.x, alien.y, rgb_to_uint32(128, 0, 0));
+                frame_capture_push(capture, world.buffer, snapshot->game.tick);
             }
-            else
+
+            // The texture already holds the last frame, so only the
+            // rectangles that were just redrawn need to go up
+            PROFILE_SCOPE(PROFILE_UPLOAD);
+            const void* pixels = params.indexed ? (const void*)params.indexed_buffer.data : params.buffer.data;
+            upload_ring_upload(upload_ring, pixels, world.dirty.rects, world.dirty.num_rects);
+
+            // 1 KB, so palette swaps cost nothing extra
+            if(params.indexed)
             {
-                const SpriteAnimation& animation = alien_animation[alien.type - 1];
-                size_t current_frame = animation.time / animation.frame_duration;
-                const Sprite& sprite = *animation.frames[current_frame];
-                buffer_draw_sprite(&params.buffer, sprite, alien.x, alien.y, rgb_to_uint32(128, 0, 0));
+                glActiveTexture(GL_TEXTURE1);
+                glTexSubImage2D(
+                    GL_TEXTURE_2D, 0, 0, 0, PALETTE_SIZE, 1,
+                    GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, world.palette
+                );
+                glActiveTexture(GL_TEXTURE0);
             }
         }
 
-        for(size_t bi = 0; bi < game.num_bullets; ++bi)
         {
-            const Bullet& bullet = game.bullets[bi];
-            const Sprite& sprite = sprites.bullet_sprite;
-            buffer_draw_sprite(&params.buffer, sprite, bullet.x, bullet.y, rgb_to_uint32(128, 0, 0));
+            PROFILE_SCOPE(PROFILE_PRESENT);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glfwSwapBuffers(params.window);
         }
 
-        buffer_draw_sprite(&params.buffer, sprites.player_sprite, game.player.x, game.player.y, rgb_to_uint32(128, 0, 0));
+        // The swap is the closest this side of the display gets to photons
+        if(snapshot) input_latency_record(consumed_events, snapshot->game.tick, monotonic_time_ns());
 
-        // Update animations
-        for(size_t i = 0; i < 3; ++i)
         {
-            ++alien_animation[i].time;
-            if(alien_animation[i].time == alien_animation[i].num_frames * alien_animation[i].frame_duration)
-            {
-                alien_animation[i].time = 0;
-            }
+            PROFILE_SCOPE(PROFILE_POLL_EVENTS);
+            glfwPollEvents();
         }
 
-        glTexSubImage2D(
-            GL_TEXTURE_2D, 0, 0, 0,
-            params.buffer.width, params.buffer.height,
-            GL_RGBA, GL_UNSIGNED_INT_8_8_8_8,
-            params.buffer.data
-        );
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glfwSwapBuffers(params.window);
+        uint64_t now_ns = monotonic_time_ns();
+        frame_stats_add(render_stats, now_ns - last_frame_ns);
+        last_frame_ns = now_ns;
 
-        // Simulate aliens
-        for(size_t ai = 0; ai < game.num_aliens; ++ai)
+        if(max_frames && render_stats.count >= max_frames) break;
+    }
+
+    sim_thread_stop(sim);
+    bool capture_failed = false;
+    if(capturing)
+    {
+        capture_failed = !frame_capture_stop(capture);
+        frame_capture_print_stats(capture, stdout);
+    }
+    if(session.input_queue.dropped || consumed_events.dropped || sim.input_state.dropped_fires)
+    {
+        printf(
+            "Input events dropped: %u queued, %u latency samples, %zu fire presses\n",
+            session.input_queue.dropped, consumed_events.dropped, sim.input_state.dropped_fires
+        );
+    }
+    if(max_frames)
+    {
+        bool match = texture_matches_buffer(params);
+        printf(
+            "Texture matches buffer (%s upload, %s): %d\n",
+            use_pbo ? "pbo" : "client", params.indexed ? "indexed" : "rgba", match
+        );
+    }
+    frame_stats_print(sim.tick_stats, "Simulation tick");
+    frame_stats_print(render_stats, "Render frame");
+    profiler_print_summary(stdout);
+    if(trace_path) profiler_write_chrome_trace(trace_path);
+    triple_buffer_destroy(snapshots);
+    snapshot_ring_destroy(history);
+
+    bool record_failed = false;
+    if(record_path)
+    {
+        recording.final_checksum = world_checksum(world);
+        if(input_recording_save(recording, record_path))
         {
-            const Alien& alien = game.aliens[ai];
-            if(alien.type == ALIEN_DEAD && death_counters[ai])
-            {
-                --death_counters[ai];
-            }
+            printf("Recorded %zu ticks to %s\n", recording.num_ticks, record_path);
         }
-
-        // Simulate bullets
-        for(size_t bi = 0; bi < game.num_bullets;)
+        else
         {
-            game.bullets[bi].y += game.bullets[bi].dir;
-            if(game.bullets[bi].y >= game.height || game.bullets[bi].y < sprites.bullet_sprite.height)
-            {
-                game.bullets[bi] = game.bullets[game.num_bullets - 1];
-                --game.num_bullets;
-                continue;
-            }
-
-            // Check hit
-            for(size_t ai = 0; ai < game.num_aliens; ++ai)
-            {
-                const Alien& alien = game.aliens[ai];
-                if(alien.type == ALIEN_DEAD) continue;
-
-                const SpriteAnimation& animation = alien_animation[alien.type - 1];
-                size_t current_frame = animation.time / animation.frame_duration;
-                const Sprite& alien_sprite = *animation.frames[current_frame];
-                bool overlap = sprite_overlap_check(
-                    sprites.bullet_sprite, game.bullets[bi].x, game.bullets[bi].y,
-                    alien_sprite, alien.x, alien.y
-                );
-                if(overlap)
-                {
-                    game.aliens[ai].type = ALIEN_DEAD;
-                    // NOTE: Hack to recenter death sprite
-                    game.aliens[ai].x -= (sprites.alien_death_sprite.width - alien_sprite.width)/2;
-                    game.bullets[bi] = game.bullets[game.num_bullets - 1];
-                    --game.num_bullets;
-                    continue;
-                }
-            }
-
-            ++bi;
+            record_failed = true;
         }
-
-        simulate_player(game, sprites);
-        process_events(game, sprites);
-        glfwPollEvents();
     }
+    input_recording_destroy(recording);
 
-    destory_all(params, sprites, alien_animation, game, death_counters);
+    upload_ring_destroy(upload_ring);
+    destory_all(params);
+    band_renderer_destroy(band_renderer);
+    world_destroy(world);
 
-    return 0;
+    return capture_failed || record_failed ? 1 : 0;
 }
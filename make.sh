@@ -1,4 +1,12 @@
 #!/bin/bash
 
-g++ -Wall -std=c++11 -O0 -g -o main main.cpp -I./stb  -lglfw -lGLEW -lGL
+# Debug build. For optimised builds use CMake, e.g.
+#   cmake --preset release && cmake --build --preset release
 
+# PNG frame capture needs the stb submodule (git submodule update --init)
+CAPTURE_FLAGS=""
+if [ -f stb/stb_image_write.h ]; then CAPTURE_FLAGS="-I./stb -DCAPTURE_PNG=1"; fi
+
+g++ -Wall -std=c++14 -O0 -g -o main main.cpp arena.cpp bunkers.cpp capture.cpp entities.cpp env.cpp game.cpp grid.cpp input.cpp pipeline.cpp profiler.cpp render.cpp replay.cpp snapshot.cpp sprite.cpp thread_pool.cpp timestep.cpp -I./stb $CAPTURE_FLAGS -lglfw -lGLEW -lGL -pthread
+g++ -Wall -std=c++14 -O0 -g -o bench bench.cpp arena.cpp bunkers.cpp capture.cpp entities.cpp env.cpp game.cpp grid.cpp input.cpp pipeline.cpp profiler.cpp render.cpp replay.cpp snapshot.cpp sprite.cpp thread_pool.cpp timestep.cpp $CAPTURE_FLAGS -pthread
+g++ -Wall -std=c++14 -O0 -g -o microbench microbench.cpp arena.cpp bunkers.cpp capture.cpp entities.cpp env.cpp game.cpp grid.cpp input.cpp pipeline.cpp profiler.cpp render.cpp replay.cpp snapshot.cpp sprite.cpp thread_pool.cpp timestep.cpp $CAPTURE_FLAGS -pthread
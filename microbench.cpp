@@ -0,0 +1,459 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "bunkers.h"
+#include "entities.h"
+#include "sprite.h"
+
+// Microbenchmarks for the hot kernels, one CSV row per case:
+//
+//   benchmark,case,size,ns_per_op
+//
+// Each case is timed in batches sized to take a few milliseconds and the
+// fastest of several batches is reported, so results can be diffed between
+// commits with little noise.
+//
+//   ./microbench [--filter NAME] [--repeats N] [--out PATH]
+
+typedef std::chrono::steady_clock micro_clock;
+
+// Keeps a value alive so the compiler cannot drop the work producing it
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    volatile const T* sink = &value;
+    (void)sink;
+#endif
+}
+
+inline void clobber_memory()
+{
+#if defined(__GNUC__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+struct MicroBench
+{
+    FILE* out;
+    const char* filter;
+    int repeats;
+};
+
+// Times op() and writes one result row. op may do several operations per
+// call; ops_per_call scales the result back to one.
+template <typename Op>
+void run_case(MicroBench& mb, const char* benchmark, const char* name, size_t size, size_t ops_per_call, Op op)
+{
+    if(mb.filter && !strstr(benchmark, mb.filter)) return;
+
+    // Grow the batch until it takes at least 2ms
+    size_t batch = 1;
+    for(;;)
+    {
+        micro_clock::time_point start = micro_clock::now();
+        for(size_t i = 0; i < batch; ++i) op();
+        double ns = std::chrono::duration<double, std::nano>(micro_clock::now() - start).count();
+        if(ns > 2e6 || batch >= (1u << 30)) break;
+        batch *= 2;
+    }
+
+    double best_ns = 1e300;
+    for(int r = 0; r < mb.repeats; ++r)
+    {
+        micro_clock::time_point start = micro_clock::now();
+        for(size_t i = 0; i < batch; ++i) op();
+        double ns = std::chrono::duration<double, std::nano>(micro_clock::now() - start).count();
+        if(ns < best_ns) best_ns = ns;
+    }
+
+    fprintf(mb.out, "%s,%s,%zu,%.3f\n", benchmark, name, size, best_ns / (double)(batch * ops_per_call));
+    fflush(mb.out);
+}
+
+// Deterministic sprite with roughly half its pixels set
+void make_sprite(Sprite& sprite, size_t width, size_t height, uint32_t seed)
+{
+    uint8_t* data = new uint8_t[width * height];
+    for(size_t i = 0; i < width * height; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        data[i] = (seed >> 31) & 1;
+    }
+    sprite.width = width;
+    sprite.height = height;
+    sprite.data = data;
+    pack_sprite(sprite);
+}
+
+void bench_buffer_clear(MicroBench& mb)
+{
+    static const size_t sizes[][2] = {{600, 400}, {1920, 1080}, {3840, 2160}};
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        Buffer buffer;
+        buffer.width = sizes[s][0];
+        buffer.height = sizes[s][1];
+        buffer.data = new uint32_t[buffer.width * buffer.height];
+        char name[32];
+        snprintf(name, sizeof(name), "%zux%zu", buffer.width, buffer.height);
+        uint32_t color = rgb_to_uint32(0, 128, 0);
+        run_case(mb, "buffer_clear", name, buffer.width * buffer.height, 1, [&]()
+        {
+            buffer_clear(&buffer, color);
+            clobber_memory();
+        });
+
+        IndexedBuffer indexed = {buffer.width, buffer.height, new uint8_t[buffer.width * buffer.height]};
+        run_case(mb, "indexed_buffer_clear", name, indexed.width * indexed.height, 1, [&]()
+        {
+            buffer_clear(&indexed, 1);
+            clobber_memory();
+        });
+
+        delete[] indexed.data;
+        delete[] buffer.data;
+    }
+}
+
+// Both blitters over a range of sprite sizes and the clip cases they handle
+void bench_draw_sprite(MicroBench& mb)
+{
+    static const size_t sizes[][2] = {{1, 3}, {8, 8}, {11, 8}, {12, 8}, {16, 16}, {32, 32}, {64, 32}};
+
+    enum ClipCase { CLIP_INSIDE, CLIP_LEFT, CLIP_RIGHT, CLIP_BOTTOM, CLIP_TOP, CLIP_OUTSIDE, NUM_CLIP_CASES };
+    static const char* clip_names[NUM_CLIP_CASES] = {"inside", "left", "right", "bottom", "top", "outside"};
+
+    Buffer buffer;
+    buffer.width = 600;
+    buffer.height = 400;
+    buffer.data = new uint32_t[buffer.width * buffer.height];
+    buffer_clear(&buffer, 0);
+    uint32_t color = rgb_to_uint32(128, 0, 0);
+
+    IndexedBuffer indexed = {buffer.width, buffer.height, new uint8_t[buffer.width * buffer.height]};
+    buffer_clear(&indexed, 0);
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        Sprite sprite;
+        make_sprite(sprite, sizes[s][0], sizes[s][1], (uint32_t)s + 1);
+
+        for(int c = 0; c < NUM_CLIP_CASES; ++c)
+        {
+            // Half the sprite hangs off the named edge; wrapped size_t
+            // coordinates stand in for negative ones
+            size_t x = 300, y = 200;
+            switch(c)
+            {
+            case CLIP_LEFT:    x = (size_t)0 - sprite.width / 2; break;
+            case CLIP_RIGHT:   x = buffer.width - sprite.width / 2; break;
+            case CLIP_BOTTOM:  y = (size_t)0 - sprite.height / 2; break;
+            case CLIP_TOP:     y = buffer.height - sprite.height / 2; break;
+            case CLIP_OUTSIDE: x = buffer.width + 10; break;
+            default: break;
+            }
+
+            char name[48];
+            snprintf(name, sizeof(name), "%zux%zu/%s", sprite.width, sprite.height, clip_names[c]);
+            run_case(mb, "buffer_draw_sprite", name, sprite.width * sprite.height, 1, [&]()
+            {
+                buffer_draw_sprite(&buffer, sprite, x, y, color);
+                clobber_memory();
+            });
+            run_case(mb, "buffer_draw_packed_sprite", name, sprite.width * sprite.height, 1, [&]()
+            {
+                buffer_draw_packed_sprite(&buffer, sprite.packed, x, y, color);
+                clobber_memory();
+            });
+            run_case(mb, "indexed_draw_packed_sprite", name, sprite.width * sprite.height, 1, [&]()
+            {
+                buffer_draw_packed_sprite(&indexed, sprite.packed, x, y, 1);
+                clobber_memory();
+            });
+        }
+
+        delete[] sprite.data;
+    }
+
+    delete[] indexed.data;
+    delete[] buffer.data;
+}
+
+void bench_overlap_check(MicroBench& mb)
+{
+    Sprite a, b;
+    make_sprite(a, 12, 8, 7);
+    make_sprite(b, 1, 3, 11);
+
+    // Checks per call, over positions that cycle through hits and misses
+    const size_t n = 1024;
+    size_t xs[n], ys[n];
+    uint32_t seed = 42;
+    for(size_t i = 0; i < n; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        xs[i] = 100 + (seed >> 16) % 24;
+        ys[i] = 100 + (seed >> 8) % 16;
+    }
+
+    run_case(mb, "sprite_overlap_check", "mixed", n, n, [&]()
+    {
+        size_t hits = 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            hits += sprite_overlap_check(b, xs[i], ys[i], a, 110, 104);
+        }
+        do_not_optimize(hits);
+    });
+    // The rectangle test alone, as the floor for the narrowphase above
+    run_case(mb, "sprite_boxes_overlap", "mixed", n, n, [&]()
+    {
+        size_t hits = 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            hits += sprite_boxes_overlap(b.packed, xs[i], ys[i], a.packed, 110, 104);
+        }
+        do_not_optimize(hits);
+    });
+    run_case(mb, "sprite_overlap_check", "hit", 1, 1, [&]()
+    {
+        size_t x = 112;
+        do_not_optimize(x);
+        bool hit = sprite_overlap_check(b, x, 105, a, 110, 104);
+        do_not_optimize(hit);
+    });
+    run_case(mb, "sprite_overlap_check", "miss", 1, 1, [&]()
+    {
+        size_t x = 300;
+        do_not_optimize(x);
+        bool hit = sprite_overlap_check(b, x, 105, a, 110, 104);
+        do_not_optimize(hit);
+    });
+
+    delete[] a.data;
+    delete[] b.data;
+}
+
+void bench_rgb_to_uint32(MicroBench& mb)
+{
+    const size_t n = 1024;
+    uint8_t channels[n * 3];
+    for(size_t i = 0; i < n * 3; ++i) channels[i] = (uint8_t)(i * 37);
+    uint32_t out[n];
+
+    run_case(mb, "rgb_to_uint32", "array", n, n, [&]()
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            out[i] = rgb_to_uint32(channels[3 * i], channels[3 * i + 1], channels[3 * i + 2]);
+        }
+        clobber_memory();
+        do_not_optimize(out[0]);
+    });
+}
+
+// One tick of bullet work: advance every bullet, then swap-remove the ones
+// that left the field. The store is refilled each call so the count stays put.
+void bench_bullets(MicroBench& mb)
+{
+    static const size_t counts[] = {1, 8, 32, 64, 128};
+    static const int exit_percents[] = {0, 25, 100};
+
+    Arena arena;
+    arena_init(arena, 2 * bullet_store_bytes(GAME_MAX_BULLETS, GAME_MAX_BULLETS));
+    BulletStore initial, bullets;
+    bullet_store_init(initial, GAME_MAX_BULLETS, arena, GAME_MAX_BULLETS);
+    bullet_store_init(bullets, GAME_MAX_BULLETS, arena, GAME_MAX_BULLETS);
+
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        for(size_t e = 0; e < sizeof(exit_percents) / sizeof(exit_percents[0]); ++e)
+        {
+            initial.count = 0;
+            for(size_t i = 0; i < counts[c]; ++i)
+            {
+                // Exiting bullets start one step from the top edge
+                bool exits = (int)(i * 100 / counts[c]) < exit_percents[e];
+                bullets_spawn(initial, (int16_t)(i * 4), exits ? 399 : (int16_t)(20 + i), 2);
+            }
+
+            char name[32];
+            snprintf(name, sizeof(name), "exit%d", exit_percents[e]);
+            run_case(mb, "bullets_advance_remove", name, counts[c], 1, [&]()
+            {
+                bullet_store_copy(bullets, initial);
+                bullets_advance(bullets);
+                for(size_t bi = 0; bi < bullets.count;)
+                {
+                    if(bullets.y[bi] >= 400) bullets_remove(bullets, bi);
+                    else ++bi;
+                }
+                do_not_optimize(bullets.count);
+                clobber_memory();
+            });
+        }
+    }
+
+    arena_destroy(arena);
+}
+
+// Solid width x height sprite
+void make_solid_sprite(Sprite& sprite, size_t width, size_t height)
+{
+    uint8_t* data = new uint8_t[width * height];
+    memset(data, 1, width * height);
+    sprite.width = width;
+    sprite.height = height;
+    sprite.data = data;
+    pack_sprite(sprite);
+}
+
+void bench_bunkers(MicroBench& mb)
+{
+    static const size_t counts[] = {8, 32, 128};
+    static const int hit_percents[] = {0, 25, 100};
+
+    Sprite shape, bullet, stamp;
+    make_solid_sprite(shape, 22, 16);
+    make_solid_sprite(bullet, 1, 3);
+    make_solid_sprite(stamp, 6, 6);
+
+    BunkerField initial_bunkers;
+    bunkers_init(initial_bunkers, shape.packed, 4, 64, 64, 150);
+
+    Arena arena;
+    arena_init(arena, 2 * bullet_store_bytes(GAME_MAX_BULLETS, GAME_MAX_BULLETS));
+    BulletStore initial_bullets, bullets;
+    bullet_store_init(initial_bullets, GAME_MAX_BULLETS, arena, GAME_MAX_BULLETS);
+    bullet_store_init(bullets, GAME_MAX_BULLETS, arena, GAME_MAX_BULLETS);
+    uint32_t scratch[GAME_MAX_BULLETS];
+
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        for(size_t h = 0; h < sizeof(hit_percents) / sizeof(hit_percents[0]); ++h)
+        {
+            initial_bullets.count = 0;
+            for(size_t i = 0; i < counts[c]; ++i)
+            {
+                // Hitting bullets sit inside a bunker, the rest above them
+                bool hits = (int)(i * 100 / counts[c]) < hit_percents[h];
+                int16_t x = (int16_t)(64 + (i % 4) * 150 + i % 22);
+                bullets_spawn(initial_bullets, x, hits ? 70 : (int16_t)(120 + i), 2);
+            }
+
+            BunkerField bunkers;
+            char name[32];
+            snprintf(name, sizeof(name), "hit%d", hit_percents[h]);
+            run_case(mb, "bunkers_resolve_bullets", name, counts[c], 1, [&]()
+            {
+                bunkers = initial_bunkers;
+                bullet_store_copy(bullets, initial_bullets);
+                size_t num_hits = bunkers_resolve_bullets(bunkers, bullets, bullet.packed, stamp.packed, scratch);
+                do_not_optimize(num_hits);
+                clobber_memory();
+            });
+        }
+    }
+
+    arena_destroy(arena);
+    delete[] shape.data;
+    delete[] bullet.data;
+    delete[] stamp.data;
+}
+
+void bench_aliens(MicroBench& mb)
+{
+    static const size_t counts[] = {66, 1024, 16384, 65536};
+
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        Arena arena;
+        arena_init(arena, alien_store_bytes(counts[c]));
+        AlienStore aliens;
+        alien_store_init(aliens, counts[c], arena);
+        uint32_t* expired = new uint32_t[counts[c]];
+        for(size_t i = 0; i < aliens.count; ++i)
+        {
+            aliens.x[i] = (int16_t)(i % 600);
+            aliens.y[i] = (int16_t)(i % 400);
+            aliens.type[i] = (uint8_t)(i % 4);
+        }
+
+        // A late wave: a quarter alive, a quarter showing death sprites
+        // with staggered timers, the rest gone. Once every death sprite
+        // has expired the range is refilled, which amortizes to nothing.
+        auto arm = [&aliens]()
+        {
+            aliens.num_live = aliens.count / 4;
+            aliens.num_shown = aliens.count / 2;
+            for(size_t i = aliens.num_live; i < aliens.num_shown; ++i)
+            {
+                aliens.death_timer[i] = (uint8_t)(1 + i % 255);
+            }
+        };
+        arm();
+
+        run_case(mb, "aliens_update_death_timers", "late_wave", aliens.count, 1, [&]()
+        {
+            aliens_update_death_timers(aliens, expired);
+            if(aliens.num_shown == aliens.num_live) arm();
+            clobber_memory();
+        });
+
+        delete[] expired;
+        arena_destroy(arena);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    MicroBench mb;
+    mb.out = stdout;
+    mb.filter = NULL;
+    mb.repeats = 5;
+    const char* out_path = NULL;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--filter") && i + 1 < argc) mb.filter = argv[++i];
+        else if(!strcmp(argv[i], "--repeats") && i + 1 < argc) mb.repeats = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--out") && i + 1 < argc) out_path = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter NAME] [--repeats N] [--out PATH]\n", argv[0]);
+            return -1;
+        }
+    }
+    if(mb.repeats < 1) mb.repeats = 1;
+
+    if(out_path)
+    {
+        mb.out = fopen(out_path, "w");
+        if(!mb.out)
+        {
+            fprintf(stderr, "Error: could not open %s\n", out_path);
+            return -1;
+        }
+    }
+
+    fprintf(mb.out, "benchmark,case,size,ns_per_op\n");
+    bench_buffer_clear(mb);
+    bench_draw_sprite(mb);
+    bench_overlap_check(mb);
+    bench_rgb_to_uint32(mb);
+    bench_bullets(mb);
+    bench_aliens(mb);
+    bench_bunkers(mb);
+
+    if(mb.out != stdout) fclose(mb.out);
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+constexpr uint8_t SNAPSHOT_FRESH = 0x4;
+constexpr uint8_t SNAPSHOT_INDEX = 0x3;
+
+void game_snapshot_init(GameSnapshot& snapshot, size_t num_aliens, size_t max_bullets)
+{
+    snapshot = {};
+    arena_init(snapshot.arena, alien_store_bytes(num_aliens) + bullet_store_bytes(max_bullets, max_bullets));
+    alien_store_init(snapshot.game.aliens, num_aliens, snapshot.arena);
+    bullet_store_init(snapshot.game.bullets, max_bullets, snapshot.arena, max_bullets);
+}
+
+void game_snapshot_destroy(GameSnapshot& snapshot)
+{
+    arena_destroy(snapshot.arena);
+}
+
+void game_snapshot_capture(GameSnapshot& snapshot, const World& world, uint64_t now_ns)
+{
+    // Keep this snapshot's own alien and bullet arrays across the struct copy
+    AlienStore aliens = snapshot.game.aliens;
+    BulletStore bullets = snapshot.game.bullets;
+    snapshot.game = world.game;
+    snapshot.game.aliens = aliens;
+    snapshot.game.bullets = bullets;
+    alien_store_copy(snapshot.game.aliens, world.game.aliens);
+    bullet_store_copy(snapshot.game.bullets, world.game.bullets);
+
+    snapshot.animation_clock = world.animation_clock;
+    snapshot.prev_player_x = world.prev_player_x;
+    snapshot.publish_time_ns = now_ns;
+}
+
+void world_draw_snapshot(World& world, const GameSnapshot& snapshot, double alpha)
+{
+    build_draw_list(world, snapshot.game, snapshot.animation_clock, snapshot.prev_player_x, alpha);
+    world_render(world);
+}
+
+void triple_buffer_init(SnapshotTripleBuffer& buffer, size_t num_aliens, size_t max_bullets)
+{
+    for(size_t i = 0; i < 3; ++i)
+    {
+        game_snapshot_init(buffer.slots[i], num_aliens, max_bullets);
+    }
+    buffer.back = 0;
+    buffer.middle.store(1, std::memory_order_relaxed);
+    buffer.front = 2;
+    buffer.has_front = false;
+}
+
+void triple_buffer_destroy(SnapshotTripleBuffer& buffer)
+{
+    for(size_t i = 0; i < 3; ++i)
+    {
+        game_snapshot_destroy(buffer.slots[i]);
+    }
+}
+
+GameSnapshot& triple_buffer_back(SnapshotTripleBuffer& buffer)
+{
+    return buffer.slots[buffer.back];
+}
+
+void triple_buffer_publish(SnapshotTripleBuffer& buffer)
+{
+    uint8_t previous = buffer.middle.exchange(buffer.back | SNAPSHOT_FRESH, std::memory_order_acq_rel);
+    buffer.back = previous & SNAPSHOT_INDEX;
+}
+
+const GameSnapshot* triple_buffer_acquire(SnapshotTripleBuffer& buffer)
+{
+    if(buffer.middle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH)
+    {
+        uint8_t previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+        buffer.front = previous & SNAPSHOT_INDEX;
+        buffer.has_front = true;
+    }
+
+    return buffer.has_front ? &buffer.slots[buffer.front] : NULL;
+}
+
+void frame_stats_add(FrameStats& stats, uint64_t ns)
+{
+    if(stats.count == 0 || ns < stats.min_ns) stats.min_ns = ns;
+    if(ns > stats.max_ns) stats.max_ns = ns;
+    stats.total_ns += ns;
+    ++stats.count;
+}
+
+void frame_stats_print(const FrameStats& stats, const char* name)
+{
+    double mean_ms = stats.count ? stats.total_ns / 1e6 / stats.count : 0.0;
+    printf(
+        "%s: %llu frames, mean %.3f ms, min %.3f ms, max %.3f ms\n",
+        name, (unsigned long long)stats.count, mean_ms, stats.min_ns / 1e6, stats.max_ns / 1e6
+    );
+}
+
+static void sim_thread_main(SimThread* sim)
+{
+    FixedTimestep timestep;
+    timestep_init(timestep, SIM_TICK_NS, SIM_MAX_CATCHUP_TICKS, monotonic_time_ns());
+
+    while(sim->running.load(std::memory_order_relaxed))
+    {
+        size_t num_ticks = timestep_advance(timestep, monotonic_time_ns());
+        for(size_t i = 0; i < num_ticks; ++i)
+        {
+            uint64_t tick_start = monotonic_time_ns();
+
+            World& world = *sim->world;
+            Input input = input_state_drain(sim->input_state, *sim->input, sim->consumed, world.game.tick);
+            if(sim->history && sim->input_state.rewind_held)
+            {
+                // Stops at the oldest state still held
+                if(world.game.tick > 0) snapshot_ring_rewind(*sim->history, world.game.tick - 1, world);
+            }
+            else
+            {
+                if(sim->recording) input_recording_push(*sim->recording, input);
+                world_tick(world, input);
+                if(sim->history) snapshot_ring_push(*sim->history, world);
+            }
+
+            frame_stats_add(sim->tick_stats, monotonic_time_ns() - tick_start);
+        }
+
+        if(num_ticks)
+        {
+            game_snapshot_capture(triple_buffer_back(*sim->snapshots), *sim->world, monotonic_time_ns());
+            triple_buffer_publish(*sim->snapshots);
+        }
+
+        // Sleep off the rest of the tick instead of spinning
+        uint64_t remaining_ns = timestep.tick_ns - std::min(timestep.accumulator_ns, timestep.tick_ns);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(remaining_ns));
+    }
+}
+
+void sim_thread_start(
+    SimThread& sim, World* world, SnapshotTripleBuffer* snapshots,
+    InputQueue* input, InputQueue* consumed, InputRecording* recording,
+    SnapshotRing* history
+)
+{
+    sim.world = world;
+    sim.snapshots = snapshots;
+    sim.input = input;
+    sim.consumed = consumed;
+    input_state_init(sim.input_state);
+    sim.recording = recording;
+    sim.history = history;
+    if(history) snapshot_ring_push(*history, *world);
+    sim.tick_stats = {};
+    sim.running.store(true);
+    sim.thread = std::thread(sim_thread_main, &sim);
+}
+
+void sim_thread_stop(SimThread& sim)
+{
+    sim.running.store(false);
+    sim.thread.join();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "game.h"
+#include "input.h"
+#include "replay.h"
+#include "snapshot.h"
+
+// Read-only copy of everything needed to draw one simulated tick: a copy of
+// the game with its aliens and bullets in the snapshot's own arena, the
+// animation clock, and the player's previous position for interpolation.
+// Sprites are not copied; drawing takes them from the world's atlas.
+struct GameSnapshot
+{
+    // Holds game.aliens and game.bullets
+    Arena arena;
+    Game game;
+    AnimationClock animation_clock;
+    size_t prev_player_x;
+    uint64_t publish_time_ns;
+};
+
+void game_snapshot_init(GameSnapshot& snapshot, size_t num_aliens, size_t max_bullets);
+void game_snapshot_destroy(GameSnapshot& snapshot);
+void game_snapshot_capture(GameSnapshot& snapshot, const World& world, uint64_t now_ns);
+
+// Draws a snapshot with the world's sprites into the world's buffer
+void world_draw_snapshot(World& world, const GameSnapshot& snapshot, double alpha);
+
+// Single-producer single-consumer triple buffer. The producer fills the
+// back slot and swaps it with the middle one; the consumer swaps the middle
+// slot into the front when it holds something newer. Neither side blocks.
+struct SnapshotTripleBuffer
+{
+    GameSnapshot slots[3];
+    // Index of the middle slot, with SNAPSHOT_FRESH set if it is unread
+    std::atomic<uint8_t> middle;
+    uint8_t back;
+    uint8_t front;
+    bool has_front;
+};
+
+void triple_buffer_init(SnapshotTripleBuffer& buffer, size_t num_aliens, size_t max_bullets);
+void triple_buffer_destroy(SnapshotTripleBuffer& buffer);
+
+// Producer side
+GameSnapshot& triple_buffer_back(SnapshotTripleBuffer& buffer);
+void triple_buffer_publish(SnapshotTripleBuffer& buffer);
+
+// Consumer side: the newest published snapshot, or NULL before the first
+const GameSnapshot* triple_buffer_acquire(SnapshotTripleBuffer& buffer);
+
+struct FrameStats
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+};
+
+void frame_stats_add(FrameStats& stats, uint64_t ns);
+void frame_stats_print(const FrameStats& stats, const char* name);
+
+// Runs world_tick on its own thread at the fixed tick rate and publishes a
+// snapshot after each batch of ticks. Input events queued by the window
+// thread are drained at the start of every tick. With a history, every tick
+// is pushed to it and holding rewind steps back one tick per tick instead.
+struct SimThread
+{
+    World* world;
+    SnapshotTripleBuffer* snapshots;
+    InputQueue* input;
+    // Optional; events are forwarded here once applied, for latency
+    InputQueue* consumed;
+    InputState input_state;
+    // Optional; every tick's input is appended to it
+    InputRecording* recording;
+    // Optional; must not be combined with a recording, which cannot follow
+    // the session backwards
+    SnapshotRing* history;
+    std::atomic<bool> running;
+    std::thread thread;
+    // Owned by the simulation thread until sim_thread_stop returns
+    FrameStats tick_stats;
+};
+
+void sim_thread_start(
+    SimThread& sim, World* world, SnapshotTripleBuffer* snapshots,
+    InputQueue* input, InputQueue* consumed, InputRecording* recording,
+    SnapshotRing* history
+);
+void sim_thread_stop(SimThread& sim);
@@ -0,0 +1,292 @@
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+
+// Four buckets per power of two: the two bits after the leading one pick
+// the bucket, so every bucket is within 25% of its neighbours
+constexpr size_t PROFILER_NUM_BUCKETS = 256;
+
+// Threads that can record; samples from any past this are dropped
+constexpr size_t PROFILER_MAX_THREADS = 256;
+
+// Written only by the thread that owns it, so updates are plain loads and
+// stores; the atomics only let print read while it records
+struct ZoneHistogram
+{
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[PROFILER_NUM_BUCKETS];
+};
+
+// Totals of every thread's histogram for one zone
+struct MergedHistogram
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[PROFILER_NUM_BUCKETS];
+};
+
+struct ProfileSample
+{
+    uint64_t start_ns;
+    uint32_t duration_ns;
+    uint8_t zone;
+    uint8_t thread;
+};
+
+// One ring entry, guarded by a sequence number: index + 1 of the sample it
+// holds once written, RING_SLOT_BUSY while its thread rewrites it. Readers
+// skip slots that do not hold the sample they expect or change while being
+// read.
+struct RingSlot
+{
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> start_ns;
+    // duration_ns | zone << 32
+    std::atomic<uint64_t> packed;
+};
+
+constexpr uint64_t RING_SLOT_BUSY = UINT64_MAX;
+
+// Everything one thread records. Created on its first sample and kept for
+// the life of the process, so its samples outlive the thread.
+struct ThreadProfile
+{
+    ZoneHistogram histograms[NUM_PROFILE_ZONES];
+    RingSlot ring[PROFILER_RING_SIZE];
+    std::atomic<uint64_t> ring_head;
+    uint8_t thread;
+};
+
+static const char* zone_names[NUM_PROFILE_ZONES] = {
+    "build_draw_list",
+    "clear",
+    "draw_bunkers",
+    "draw_aliens",
+    "draw_bullets",
+    "draw_player",
+    "draw_band",
+    "dirty_track",
+    "draw_dirty",
+    "upload",
+    "capture",
+    "present",
+    "alien_sim",
+    "bullet_sim",
+    "input",
+    "snapshot_save",
+    "snapshot_rewind",
+    "poll_events",
+    "input_latency"
+};
+
+static std::atomic<ThreadProfile*> thread_profiles[PROFILER_MAX_THREADS];
+static std::atomic<size_t> next_thread_id(0);
+
+// The calling thread's profile, or NULL once every slot is taken
+static ThreadProfile* this_thread_profile()
+{
+    static thread_local ThreadProfile* profile = NULL;
+    static thread_local bool registered = false;
+    if(!registered)
+    {
+        registered = true;
+        size_t id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+        if(id < PROFILER_MAX_THREADS)
+        {
+            profile = new ThreadProfile();
+            profile->thread = (uint8_t)id;
+            thread_profiles[id].store(profile, std::memory_order_release);
+        }
+    }
+    return profile;
+}
+
+// Profiles registered so far; slots below the count may still be NULL
+// for a moment while their thread publishes
+static size_t num_thread_profiles()
+{
+    size_t count = next_thread_id.load(std::memory_order_acquire);
+    return count < PROFILER_MAX_THREADS ? count : PROFILER_MAX_THREADS;
+}
+
+static size_t bucket_index(uint64_t ns)
+{
+    if(ns < 4) return ns;
+    size_t msb = 63 - __builtin_clzll(ns);
+    return 4 * (msb - 1) + ((ns >> (msb - 2)) & 3);
+}
+
+static uint64_t bucket_lower_bound(size_t index)
+{
+    if(index < 4) return index;
+    size_t msb = index / 4 + 1;
+    return (uint64_t)(4 + index % 4) << (msb - 2);
+}
+
+uint64_t profiler_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+// Only the owning thread writes, so a load and a store stand in for a
+// read-modify-write
+static void add_relaxed(std::atomic<uint64_t>& value, uint64_t amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void profiler_record(ProfileZone zone, uint64_t start_ns, uint64_t end_ns)
+{
+    ThreadProfile* profile = this_thread_profile();
+    if(!profile) return;
+    uint64_t ns = end_ns - start_ns;
+
+    ZoneHistogram& histogram = profile->histograms[zone];
+    add_relaxed(histogram.count, 1);
+    add_relaxed(histogram.total_ns, ns);
+    add_relaxed(histogram.buckets[bucket_index(ns)], 1);
+    if(ns > histogram.max_ns.load(std::memory_order_relaxed)) histogram.max_ns.store(ns, std::memory_order_relaxed);
+
+    uint64_t index = profile->ring_head.load(std::memory_order_relaxed);
+    RingSlot& slot = profile->ring[index % PROFILER_RING_SIZE];
+    slot.sequence.store(RING_SLOT_BUSY, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t duration_ns = ns > UINT32_MAX ? UINT32_MAX : ns;
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.packed.store(duration_ns | (uint64_t)zone << 32, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+    profile->ring_head.store(index + 1, std::memory_order_release);
+}
+
+// Copies out the sample with this ring index; false if its slot holds
+// another sample or was rewritten while being read
+static bool ring_read(const ThreadProfile& profile, uint64_t index, ProfileSample& sample)
+{
+    const RingSlot& slot = profile.ring[index % PROFILER_RING_SIZE];
+    if(slot.sequence.load(std::memory_order_acquire) != index + 1) return false;
+
+    sample.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+    uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+    sample.duration_ns = (uint32_t)packed;
+    sample.zone = (uint8_t)(packed >> 32);
+    sample.thread = profile.thread;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == index + 1;
+}
+
+static void merge_histograms(size_t zone, MergedHistogram& merged)
+{
+    merged = {};
+    for(size_t t = 0, count = num_thread_profiles(); t < count; ++t)
+    {
+        const ThreadProfile* profile = thread_profiles[t].load(std::memory_order_acquire);
+        if(!profile) continue;
+
+        const ZoneHistogram& histogram = profile->histograms[zone];
+        merged.count += histogram.count.load(std::memory_order_relaxed);
+        merged.total_ns += histogram.total_ns.load(std::memory_order_relaxed);
+        uint64_t max_ns = histogram.max_ns.load(std::memory_order_relaxed);
+        if(max_ns > merged.max_ns) merged.max_ns = max_ns;
+        for(size_t i = 0; i < PROFILER_NUM_BUCKETS; ++i)
+        {
+            merged.buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static uint64_t histogram_percentile(const MergedHistogram& histogram, double percentile)
+{
+    uint64_t rank = (uint64_t)(percentile * (histogram.count - 1));
+    uint64_t seen = 0;
+    for(size_t i = 0; i < PROFILER_NUM_BUCKETS; ++i)
+    {
+        seen += histogram.buckets[i];
+        if(seen > rank) return bucket_lower_bound(i);
+    }
+    return histogram.max_ns;
+}
+
+void profiler_print_summary(FILE* file)
+{
+    fprintf(file, "%-16s %10s %10s %10s %10s %10s\n", "zone", "samples", "mean_us", "p50_us", "p99_us", "max_us");
+    MergedHistogram histogram;
+    for(size_t zone = 0; zone < NUM_PROFILE_ZONES; ++zone)
+    {
+        merge_histograms(zone, histogram);
+        if(histogram.count == 0) continue;
+
+        fprintf(
+            file, "%-16s %10llu %10.2f %10.2f %10.2f %10.2f\n",
+            zone_names[zone], (unsigned long long)histogram.count,
+            histogram.total_ns / 1e3 / histogram.count,
+            histogram_percentile(histogram, 0.50) / 1e3,
+            histogram_percentile(histogram, 0.99) / 1e3,
+            histogram.max_ns / 1e3
+        );
+    }
+}
+
+bool profiler_write_chrome_trace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if(!file)
+    {
+        fprintf(stderr, "Error opening %s for writing.\n", path);
+        return false;
+    }
+
+    // Each thread's ring is read from the head seen here; samples recorded
+    // after that are left for the next export
+    size_t num_threads = num_thread_profiles();
+    uint64_t heads[PROFILER_MAX_THREADS];
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        const ThreadProfile* profile = thread_profiles[t].load(std::memory_order_acquire);
+        heads[t] = profile ? profile->ring_head.load(std::memory_order_acquire) : 0;
+    }
+
+    // Timestamps relative to the oldest kept sample keep the numbers short
+    uint64_t base_ns = UINT64_MAX;
+    ProfileSample sample;
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        const ThreadProfile* profile = thread_profiles[t].load(std::memory_order_acquire);
+        uint64_t count = heads[t] < PROFILER_RING_SIZE ? heads[t] : PROFILER_RING_SIZE;
+        for(uint64_t i = heads[t] - count; i < heads[t]; ++i)
+        {
+            if(ring_read(*profile, i, sample) && sample.start_ns < base_ns) base_ns = sample.start_ns;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    for(size_t t = 0; t < num_threads; ++t)
+    {
+        const ThreadProfile* profile = thread_profiles[t].load(std::memory_order_acquire);
+        uint64_t count = heads[t] < PROFILER_RING_SIZE ? heads[t] : PROFILER_RING_SIZE;
+        for(uint64_t i = heads[t] - count; i < heads[t]; ++i)
+        {
+            if(!ring_read(*profile, i, sample) || sample.start_ns < base_ns) continue;
+            fprintf(
+                file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",",
+                zone_names[sample.zone], sample.thread,
+                (sample.start_ns - base_ns) / 1e3, sample.duration_ns / 1e3
+            );
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
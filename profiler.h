@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Scoped timers for the phases of a frame. Every sample updates a per-zone
+// log-linear histogram and is appended to a fixed-size ring of recent
+// samples for trace export. Each thread records into its own histograms and
+// ring, so threads never contend; they are merged when printed or exported.
+// Define PROFILER_ENABLED to 0 to compile the scopes out.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+enum ProfileZone: uint8_t
+{
+    PROFILE_BUILD_DRAW_LIST,
+    PROFILE_CLEAR,
+    PROFILE_DRAW_BUNKERS,
+    PROFILE_DRAW_ALIENS,
+    PROFILE_DRAW_BULLETS,
+    PROFILE_DRAW_PLAYER,
+    PROFILE_DRAW_BAND,
+    PROFILE_DIRTY_TRACK,
+    PROFILE_DRAW_DIRTY,
+    PROFILE_UPLOAD,
+    PROFILE_CAPTURE,
+    PROFILE_PRESENT,
+    PROFILE_ALIEN_SIM,
+    PROFILE_BULLET_SIM,
+    PROFILE_INPUT,
+    PROFILE_SNAPSHOT_SAVE,
+    PROFILE_SNAPSHOT_REWIND,
+    PROFILE_POLL_EVENTS,
+    // Key event to the present that first shows it, not a scope
+    PROFILE_INPUT_LATENCY,
+    NUM_PROFILE_ZONES
+};
+
+// Samples kept per thread for trace export; older ones are overwritten
+constexpr size_t PROFILER_RING_SIZE = 1 << 16;
+
+uint64_t profiler_now_ns();
+void profiler_record(ProfileZone zone, uint64_t start_ns, uint64_t end_ns);
+
+struct ProfileScope
+{
+    ProfileZone zone;
+    uint64_t start_ns;
+
+    explicit ProfileScope(ProfileZone zone): zone(zone), start_ns(profiler_now_ns()) {}
+    ~ProfileScope() { profiler_record(zone, start_ns, profiler_now_ns()); }
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(zone) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(zone)
+#else
+#define PROFILE_SCOPE(zone) ((void)0)
+#endif
+
+// p50/p99/max per zone that has samples
+void profiler_print_summary(FILE* file);
+
+// Writes the ring as Chrome trace_event JSON (chrome://tracing, Perfetto).
+// Safe while other threads record; samples overwritten mid-export are left
+// out rather than torn.
+bool profiler_write_chrome_trace(const char* path);
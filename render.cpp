@@ -0,0 +1,543 @@
+#include "render.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+void draw_list_init(DrawList& list, size_t capacity)
+{
+    list.count = 0;
+    list.capacity = capacity;
+    list.commands = new DrawCommand[capacity];
+}
+
+void draw_list_destroy(DrawList& list)
+{
+    delete[] list.commands;
+    list = {};
+}
+
+void draw_list_clear(DrawList& list)
+{
+    list.count = 0;
+    for(size_t i = 0; i < NUM_DRAW_SECTIONS; ++i)
+    {
+        list.section_end[i] = 0;
+    }
+}
+
+void draw_list_end_section(DrawList& list, DrawSection section)
+{
+    list.section_end[section] = list.count;
+}
+
+void draw_list_push(DrawList& list, const PackedSprite& sprite, int x, int y, uint32_t color, uint32_t revision)
+{
+    if(list.count == list.capacity)
+    {
+        size_t capacity = std::max<size_t>(2 * list.capacity, 64);
+        DrawCommand* commands = new DrawCommand[capacity];
+        memcpy(commands, list.commands, list.count * sizeof(DrawCommand));
+        delete[] list.commands;
+        list.commands = commands;
+        list.capacity = capacity;
+    }
+
+    DrawCommand& command = list.commands[list.count++];
+    command.sprite = &sprite;
+    command.x = x;
+    command.y = y;
+    command.color = color;
+    command.revision = revision;
+}
+
+static const ProfileZone section_zones[NUM_DRAW_SECTIONS] = {
+    PROFILE_DRAW_BUNKERS,
+    PROFILE_DRAW_ALIENS,
+    PROFILE_DRAW_BULLETS,
+    PROFILE_DRAW_PLAYER
+};
+
+// Shared by both pixel formats; colours are palette indices when Target
+// is an IndexedBuffer
+template <typename Target>
+static void render_list(Target* buffer, const DrawList& list, uint32_t clear_color)
+{
+    {
+        PROFILE_SCOPE(PROFILE_CLEAR);
+        buffer_clear(buffer, clear_color);
+    }
+
+    size_t begin = 0;
+    for(size_t section = 0; section < NUM_DRAW_SECTIONS; ++section)
+    {
+        PROFILE_SCOPE(section_zones[section]);
+
+        size_t end = std::max(begin, list.section_end[section]);
+        for(size_t i = begin; i < end; ++i)
+        {
+            const DrawCommand& command = list.commands[i];
+            buffer_draw_packed_sprite(buffer, *command.sprite, command.x, command.y, command.color);
+        }
+        begin = end;
+    }
+
+    // Anything pushed after the last section
+    for(size_t i = begin; i < list.count; ++i)
+    {
+        const DrawCommand& command = list.commands[i];
+        buffer_draw_packed_sprite(buffer, *command.sprite, command.x, command.y, command.color);
+    }
+}
+
+void render_draw_list(Buffer* buffer, const DrawList& list, uint32_t clear_color)
+{
+    render_list(buffer, list, clear_color);
+}
+
+void render_draw_list(IndexedBuffer* buffer, const DrawList& list, uint32_t clear_index)
+{
+    render_list(buffer, list, clear_index);
+}
+
+void band_renderer_init(BandRenderer& renderer, size_t num_threads, size_t num_bands)
+{
+    renderer = {};
+    renderer.pool = thread_pool_create(num_threads);
+    renderer.num_bands = num_bands ? num_bands : 4 * thread_pool_size(renderer.pool);
+    renderer.bin_offsets = new uint32_t[renderer.num_bands + 1];
+}
+
+void band_renderer_destroy(BandRenderer& renderer)
+{
+    thread_pool_destroy(renderer.pool);
+    delete[] renderer.bin_offsets;
+    delete[] renderer.bin_commands;
+    renderer = {};
+}
+
+// Bands covered by the set rows of a command, as a half-open range
+static bool command_bands(const BandRenderer& renderer, const DrawCommand& command, size_t& first, size_t& last)
+{
+    const PackedSprite& sprite = *command.sprite;
+    if(sprite.bounds_width == 0) return false;
+
+    ptrdiff_t bottom = command.y + (ptrdiff_t)sprite.bounds_y;
+    ptrdiff_t top = bottom + (ptrdiff_t)sprite.bounds_height;
+    bottom = std::max<ptrdiff_t>(bottom, 0);
+    top = std::min<ptrdiff_t>(top, renderer.height);
+    if(bottom >= top) return false;
+
+    first = bottom / renderer.band_height;
+    last = (top - 1) / renderer.band_height + 1;
+    return true;
+}
+
+template <typename Target>
+static void render_band_rows(const BandRenderer& renderer, Target* buffer, size_t band)
+{
+    size_t row_begin = band * renderer.band_height;
+    size_t row_end = std::min(row_begin + renderer.band_height, buffer->height);
+    if(row_begin >= row_end) return;
+
+    {
+        PROFILE_SCOPE(PROFILE_CLEAR);
+        buffer_clear_rows(buffer, renderer.clear_color, row_begin, row_end);
+    }
+
+    // Bins mix sections, so a band's sprites are timed as a whole
+    PROFILE_SCOPE(PROFILE_DRAW_BAND);
+    for(uint32_t i = renderer.bin_offsets[band]; i < renderer.bin_offsets[band + 1]; ++i)
+    {
+        const DrawCommand& command = renderer.list->commands[renderer.bin_commands[i]];
+        buffer_draw_packed_sprite_rows(
+            buffer, *command.sprite, command.x, command.y, command.color,
+            row_begin, row_end
+        );
+    }
+}
+
+static void render_band(void* data, size_t band)
+{
+    BandRenderer& renderer = *(BandRenderer*)data;
+    if(renderer.indexed_buffer)
+    {
+        render_band_rows(renderer, renderer.indexed_buffer, band);
+    }
+    else
+    {
+        render_band_rows(renderer, renderer.buffer, band);
+    }
+}
+
+// Bins the commands and renders every band into whichever buffer is set
+static void render_banded(BandRenderer& renderer, size_t height, const DrawList& list, uint32_t clear_color)
+{
+    renderer.list = &list;
+    renderer.clear_color = clear_color;
+    renderer.height = height;
+    renderer.band_height = (height + renderer.num_bands - 1) / renderer.num_bands;
+
+    // Count per band, prefix sum, then fill; commands stay in draw order
+    // within each bin so overlapping sprites resolve the same way
+    uint32_t* offsets = renderer.bin_offsets;
+    memset(offsets, 0, (renderer.num_bands + 1) * sizeof(uint32_t));
+
+    size_t first, last;
+    for(size_t i = 0; i < list.count; ++i)
+    {
+        if(!command_bands(renderer, list.commands[i], first, last)) continue;
+        for(size_t band = first; band < last; ++band) ++offsets[band + 1];
+    }
+    for(size_t band = 0; band < renderer.num_bands; ++band)
+    {
+        offsets[band + 1] += offsets[band];
+    }
+
+    size_t num_entries = offsets[renderer.num_bands];
+    if(num_entries > renderer.bin_capacity)
+    {
+        delete[] renderer.bin_commands;
+        renderer.bin_capacity = std::max(num_entries, 2 * renderer.bin_capacity);
+        renderer.bin_commands = new uint32_t[renderer.bin_capacity];
+    }
+
+    for(size_t i = 0; i < list.count; ++i)
+    {
+        if(!command_bands(renderer, list.commands[i], first, last)) continue;
+        for(size_t band = first; band < last; ++band)
+        {
+            renderer.bin_commands[offsets[band]++] = i;
+        }
+    }
+
+    // The fill pass advanced every offset to the start of the next band
+    for(size_t band = renderer.num_bands; band > 0; --band)
+    {
+        offsets[band] = offsets[band - 1];
+    }
+    offsets[0] = 0;
+
+    thread_pool_for(renderer.pool, renderer.num_bands, render_band, &renderer);
+}
+
+void render_draw_list_banded(BandRenderer& renderer, Buffer* buffer, const DrawList& list, uint32_t clear_color)
+{
+    renderer.buffer = buffer;
+    renderer.indexed_buffer = NULL;
+    render_banded(renderer, buffer->height, list, clear_color);
+}
+
+void render_draw_list_banded(BandRenderer& renderer, IndexedBuffer* buffer, const DrawList& list, uint32_t clear_index)
+{
+    renderer.buffer = NULL;
+    renderer.indexed_buffer = buffer;
+    render_banded(renderer, buffer->height, list, clear_index);
+}
+
+// Buffer area covered by a command's set pixels, clipped to width x height
+static bool command_rect(const DrawCommand& command, size_t width, size_t height, DirtyRect& rect)
+{
+    const PackedSprite& sprite = *command.sprite;
+    if(sprite.bounds_width == 0) return false;
+
+    ptrdiff_t left = command.x + (ptrdiff_t)sprite.bounds_x;
+    ptrdiff_t bottom = command.y + (ptrdiff_t)sprite.bounds_y;
+    ptrdiff_t right = std::min<ptrdiff_t>(left + sprite.bounds_width, width);
+    ptrdiff_t top = std::min<ptrdiff_t>(bottom + sprite.bounds_height, height);
+    left = std::max<ptrdiff_t>(left, 0);
+    bottom = std::max<ptrdiff_t>(bottom, 0);
+    if(left >= right || bottom >= top) return false;
+
+    rect.x = left;
+    rect.y = bottom;
+    rect.width = right - left;
+    rect.height = top - bottom;
+    return true;
+}
+
+static bool commands_equal(const DrawCommand& a, const DrawCommand& b)
+{
+    return a.sprite == b.sprite && a.x == b.x && a.y == b.y && a.color == b.color &&
+           a.revision == b.revision;
+}
+
+static size_t command_hash(const DrawCommand& command)
+{
+    uint64_t h = (uint64_t)(uintptr_t)command.sprite;
+    h = (h ^ (uint32_t)command.x) * 0x9e3779b97f4a7c15ull;
+    h = (h ^ (uint32_t)command.y) * 0x9e3779b97f4a7c15ull;
+    h = (h ^ command.color) * 0x9e3779b97f4a7c15ull;
+    h = (h ^ command.revision) * 0x9e3779b97f4a7c15ull;
+    return h >> 32;
+}
+
+// Sizes the previous-frame storage and its hash table for count commands
+static void dirty_tracker_reserve(DirtyTracker& tracker, size_t count)
+{
+    if(count <= tracker.prev_capacity) return;
+
+    delete[] tracker.prev_commands;
+    delete[] tracker.prev_matched;
+    delete[] tracker.hash_slots;
+
+    tracker.prev_capacity = std::max(count, 2 * tracker.prev_capacity);
+    tracker.prev_commands = new DrawCommand[tracker.prev_capacity];
+    tracker.prev_matched = new uint8_t[tracker.prev_capacity];
+
+    // Power of two, at most half full
+    tracker.hash_capacity = 1;
+    while(tracker.hash_capacity < 2 * tracker.prev_capacity) tracker.hash_capacity *= 2;
+    tracker.hash_slots = new uint32_t[tracker.hash_capacity];
+}
+
+void dirty_tracker_init(DirtyTracker& tracker, size_t width, size_t height, size_t tile_size)
+{
+    tracker = {};
+    tracker.width = width;
+    tracker.height = height;
+    tracker.tile_size = tile_size;
+    tracker.num_cols = (width + tile_size - 1) / tile_size;
+    tracker.num_rows = (height + tile_size - 1) / tile_size;
+    tracker.tiles = new uint8_t[tracker.num_cols * tracker.num_rows];
+    // Runs in a row are separated by a clean tile, so this is never reached
+    tracker.rects = new DirtyRect[tracker.num_cols * tracker.num_rows];
+    tracker.open_rects = new uint32_t[tracker.num_cols];
+    tracker.tile_rects = new uint32_t[tracker.num_cols * tracker.num_rows];
+    tracker.rect_stamps = new uint32_t[tracker.num_cols * tracker.num_rows];
+    tracker.enabled = true;
+    dirty_tracker_reserve(tracker, 64);
+}
+
+void dirty_tracker_destroy(DirtyTracker& tracker)
+{
+    delete[] tracker.tiles;
+    delete[] tracker.prev_commands;
+    delete[] tracker.prev_matched;
+    delete[] tracker.hash_slots;
+    delete[] tracker.rects;
+    delete[] tracker.open_rects;
+    delete[] tracker.tile_rects;
+    delete[] tracker.rect_stamps;
+    tracker = {};
+}
+
+void dirty_tracker_invalidate(DirtyTracker& tracker)
+{
+    tracker.valid = false;
+}
+
+static void mark_tiles(DirtyTracker& tracker, const DrawCommand& command)
+{
+    DirtyRect rect;
+    if(!command_rect(command, tracker.width, tracker.height, rect)) return;
+
+    size_t col_begin = rect.x / tracker.tile_size;
+    size_t col_end = (rect.x + rect.width - 1) / tracker.tile_size + 1;
+    size_t row_begin = rect.y / tracker.tile_size;
+    size_t row_end = (rect.y + rect.height - 1) / tracker.tile_size + 1;
+    for(size_t row = row_begin; row < row_end; ++row)
+    {
+        memset(tracker.tiles + row * tracker.num_cols + col_begin, 1, col_end - col_begin);
+    }
+}
+
+// Finds an unmatched previous command equal to command and marks it matched
+static bool match_previous(DirtyTracker& tracker, const DrawCommand& command)
+{
+    size_t mask = tracker.hash_capacity - 1;
+    for(size_t slot = command_hash(command) & mask; tracker.hash_slots[slot]; slot = (slot + 1) & mask)
+    {
+        uint32_t i = tracker.hash_slots[slot] - 1;
+        if(!tracker.prev_matched[i] && commands_equal(tracker.prev_commands[i], command))
+        {
+            tracker.prev_matched[i] = 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void remember_frame(DirtyTracker& tracker, const DrawList& list, uint32_t clear_color)
+{
+    dirty_tracker_reserve(tracker, list.count);
+    memcpy(tracker.prev_commands, list.commands, list.count * sizeof(DrawCommand));
+    tracker.prev_count = list.count;
+
+    size_t mask = tracker.hash_capacity - 1;
+    memset(tracker.hash_slots, 0, tracker.hash_capacity * sizeof(uint32_t));
+    for(size_t i = 0; i < list.count; ++i)
+    {
+        size_t slot = command_hash(list.commands[i]) & mask;
+        while(tracker.hash_slots[slot]) slot = (slot + 1) & mask;
+        tracker.hash_slots[slot] = i + 1;
+    }
+
+    tracker.valid = true;
+    tracker.clear_color = clear_color;
+}
+
+// Joins each row's runs of dirty tiles into rectangles, growing a rectangle
+// upwards while the row above has a run with exactly the same columns
+static void merge_tiles(DirtyTracker& tracker)
+{
+    const size_t ts = tracker.tile_size;
+    tracker.num_rects = 0;
+    tracker.dirty_pixels = 0;
+    std::fill(tracker.open_rects, tracker.open_rects + tracker.num_cols, UINT32_MAX);
+    std::fill(tracker.tile_rects, tracker.tile_rects + tracker.num_cols * tracker.num_rows, UINT32_MAX);
+
+    for(size_t row = 0; row < tracker.num_rows; ++row)
+    {
+        const uint8_t* tiles = tracker.tiles + row * tracker.num_cols;
+        uint32_t* tile_rects = tracker.tile_rects + row * tracker.num_cols;
+        size_t y = row * ts;
+        size_t height = std::min(ts, tracker.height - y);
+
+        size_t col = 0;
+        while(col < tracker.num_cols)
+        {
+            if(!tiles[col])
+            {
+                ++col;
+                continue;
+            }
+
+            size_t col_begin = col;
+            while(col < tracker.num_cols && tiles[col]) ++col;
+
+            size_t x = col_begin * ts;
+            size_t width = std::min(col * ts, tracker.width) - x;
+            tracker.dirty_pixels += width * height;
+
+            // The rectangle last started at this column, if it ends just
+            // below this row and spans the same columns
+            uint32_t open = tracker.open_rects[col_begin];
+            if(open != UINT32_MAX)
+            {
+                DirtyRect& rect = tracker.rects[open];
+                if(rect.x == x && rect.width == width && rect.y + rect.height == y)
+                {
+                    rect.height += height;
+                    std::fill(tile_rects + col_begin, tile_rects + col, open);
+                    continue;
+                }
+            }
+
+            std::fill(tile_rects + col_begin, tile_rects + col, (uint32_t)tracker.num_rects);
+            tracker.open_rects[col_begin] = tracker.num_rects;
+            tracker.rects[tracker.num_rects++] = {x, y, width, height};
+        }
+    }
+}
+
+bool dirty_tracker_update(DirtyTracker& tracker, const DrawList& list, uint32_t clear_color)
+{
+    PROFILE_SCOPE(PROFILE_DIRTY_TRACK);
+
+    const size_t num_tiles = tracker.num_cols * tracker.num_rows;
+    bool within_budget = list.count + tracker.prev_count <= DIRTY_MAX_COMMANDS_PER_TILE * num_tiles;
+    bool partial = tracker.enabled && tracker.valid && tracker.clear_color == clear_color && within_budget;
+    if(partial)
+    {
+        memset(tracker.tiles, 0, tracker.num_cols * tracker.num_rows);
+        memset(tracker.prev_matched, 0, tracker.prev_count);
+
+        // Matching ignores draw order. Overlapping sprites of different
+        // colours that only swap places in the list are not picked up.
+        for(size_t i = 0; i < list.count; ++i)
+        {
+            if(!match_previous(tracker, list.commands[i])) mark_tiles(tracker, list.commands[i]);
+        }
+        for(size_t i = 0; i < tracker.prev_count; ++i)
+        {
+            if(!tracker.prev_matched[i]) mark_tiles(tracker, tracker.prev_commands[i]);
+        }
+
+        size_t num_dirty = 0;
+        for(size_t i = 0; i < tracker.num_cols * tracker.num_rows; ++i)
+        {
+            num_dirty += tracker.tiles[i];
+        }
+        partial = num_dirty <= DIRTY_FULL_REDRAW_FRACTION * tracker.num_cols * tracker.num_rows;
+    }
+
+    if(partial)
+    {
+        merge_tiles(tracker);
+    }
+    else
+    {
+        tracker.rects[0] = {0, 0, tracker.width, tracker.height};
+        tracker.num_rects = 1;
+        tracker.dirty_pixels = tracker.width * tracker.height;
+    }
+    tracker.full = !partial;
+
+    // An over-budget list is not remembered either, which leaves the next
+    // frame a plain full redraw
+    if(tracker.enabled && within_budget)
+    {
+        remember_frame(tracker, list, clear_color);
+    }
+    else
+    {
+        tracker.prev_count = 0;
+        tracker.valid = false;
+    }
+    return partial;
+}
+
+template <typename Target>
+static void render_dirty(Target* buffer, const DrawList& list, uint32_t clear_color, DirtyTracker& tracker)
+{
+    // Rectangles are small and many, so they are timed as a whole
+    PROFILE_SCOPE(PROFILE_DRAW_DIRTY);
+    for(size_t r = 0; r < tracker.num_rects; ++r)
+    {
+        const DirtyRect& rect = tracker.rects[r];
+        buffer_clear_rect(buffer, clear_color, rect.x, rect.y, rect.width, rect.height);
+    }
+    std::fill(tracker.rect_stamps, tracker.rect_stamps + tracker.num_rects, 0);
+
+    // Rectangles do not overlap, so drawing in list order into each one a
+    // command reaches keeps every pixel's draw order
+    const size_t ts = tracker.tile_size;
+    DirtyRect bounds;
+    for(size_t i = 0; i < list.count; ++i)
+    {
+        const DrawCommand& command = list.commands[i];
+        if(!command_rect(command, buffer->width, buffer->height, bounds)) continue;
+
+        size_t col_begin = bounds.x / ts;
+        size_t col_end = (bounds.x + bounds.width - 1) / ts + 1;
+        size_t row_begin = bounds.y / ts;
+        size_t row_end = (bounds.y + bounds.height - 1) / ts + 1;
+        for(size_t row = row_begin; row < row_end; ++row)
+        {
+            const uint32_t* tile_rects = tracker.tile_rects + row * tracker.num_cols;
+            for(size_t col = col_begin; col < col_end; ++col)
+            {
+                uint32_t r = tile_rects[col];
+                if(r == UINT32_MAX || tracker.rect_stamps[r] == i + 1) continue;
+                tracker.rect_stamps[r] = i + 1;
+
+                const DirtyRect& rect = tracker.rects[r];
+                buffer_draw_packed_sprite_rect(
+                    buffer, *command.sprite, command.x, command.y, command.color,
+                    rect.x, rect.y, rect.width, rect.height
+                );
+            }
+        }
+    }
+}
+
+void render_draw_list_dirty(Buffer* buffer, const DrawList& list, uint32_t clear_color, DirtyTracker& tracker)
+{
+    render_dirty(buffer, list, clear_color, tracker);
+}
+
+void render_draw_list_dirty(IndexedBuffer* buffer, const DrawList& list, uint32_t clear_index, DirtyTracker& tracker)
+{
+    render_dirty(buffer, list, clear_index, tracker);
+}
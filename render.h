@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sprite.h"
+#include "thread_pool.h"
+
+struct DrawCommand
+{
+    const PackedSprite* sprite;
+    int x, y;
+    uint32_t color;
+    // Changes when the sprite's pixels change in place; 0 for sprites that
+    // never do
+    uint32_t revision;
+};
+
+// Consecutive groups of commands, so rendering can be profiled per group
+enum DrawSection
+{
+    DRAW_SECTION_BUNKERS,
+    DRAW_SECTION_ALIENS,
+    DRAW_SECTION_BULLETS,
+    DRAW_SECTION_PLAYER,
+    NUM_DRAW_SECTIONS
+};
+
+// Sprites for one frame in draw order; later commands paint over earlier ones
+struct DrawList
+{
+    size_t count, capacity;
+    DrawCommand* commands;
+    // One past the last command of each section
+    size_t section_end[NUM_DRAW_SECTIONS];
+};
+
+void draw_list_init(DrawList& list, size_t capacity);
+void draw_list_destroy(DrawList& list);
+void draw_list_clear(DrawList& list);
+void draw_list_push(DrawList& list, const PackedSprite& sprite, int x, int y, uint32_t color, uint32_t revision = 0);
+// Marks everything pushed so far, after the previous section, as section
+void draw_list_end_section(DrawList& list, DrawSection section);
+
+// Clears the buffer and draws every command on the calling thread. Every
+// renderer also takes an IndexedBuffer, in which case the command colours
+// and the clear colour are palette indices.
+void render_draw_list(Buffer* buffer, const DrawList& list, uint32_t clear_color);
+void render_draw_list(IndexedBuffer* buffer, const DrawList& list, uint32_t clear_index);
+
+// A region of the buffer in pixels, with rows counted bottom-up like the
+// buffer itself
+struct DirtyRect
+{
+    size_t x, y;
+    size_t width, height;
+};
+
+constexpr size_t DIRTY_TILE_SIZE = 16;
+// Past this fraction of dirty tiles a full redraw is cheaper
+constexpr double DIRTY_FULL_REDRAW_FRACTION = 0.5;
+// Past this many commands per tile across both frames, diffing the lists
+// costs more than the full redraw it could save, so it is skipped
+constexpr size_t DIRTY_MAX_COMMANDS_PER_TILE = 2;
+
+// Diffs each frame's draw list against the previous one and turns the
+// commands that appeared or disappeared into a set of buffer rectangles.
+// Only those need clearing, redrawing and uploading; everything else in the
+// buffer is still valid from the last frame.
+struct DirtyTracker
+{
+    size_t width, height;
+    size_t tile_size;
+    size_t num_cols, num_rows;
+    uint8_t* tiles;
+
+    // Last frame's commands, hashed so each new command is found in O(1)
+    DrawCommand* prev_commands;
+    uint8_t* prev_matched;
+    size_t prev_count, prev_capacity;
+    uint32_t* hash_slots;
+    size_t hash_capacity;
+
+    // Merged dirty rectangles from the last update, and the one each tile
+    // belongs to, UINT32_MAX for a clean tile
+    DirtyRect* rects;
+    size_t num_rects;
+    uint32_t* open_rects;
+    uint32_t* tile_rects;
+    // Last command drawn into each rectangle, plus one, while rendering
+    uint32_t* rect_stamps;
+    size_t dirty_pixels;
+    // The last update asked for a full redraw
+    bool full;
+
+    // When false every frame is a full redraw
+    bool enabled;
+    // The buffer holds the previous frame as drawn with clear_color
+    bool valid;
+    uint32_t clear_color;
+};
+
+void dirty_tracker_init(DirtyTracker& tracker, size_t width, size_t height, size_t tile_size);
+void dirty_tracker_destroy(DirtyTracker& tracker);
+// Forces the next update to redraw everything
+void dirty_tracker_invalidate(DirtyTracker& tracker);
+
+// Works out what changed since the last update and remembers list as the
+// new previous frame. Returns true if only tracker.rects need redrawing, or
+// false if the caller must redraw the whole buffer; tracker.rects then
+// holds one rectangle covering it. Either way the caller must render list
+// before the next update.
+bool dirty_tracker_update(DirtyTracker& tracker, const DrawList& list, uint32_t clear_color);
+
+// Clears and redraws only the rectangles of the tracker's last update, so
+// the result matches render_draw_list. Each command is looked up in the
+// tiles it covers and drawn clipped to the rectangles found there, so the
+// cost is one pass over the list plus the dirty pixels.
+void render_draw_list_dirty(Buffer* buffer, const DrawList& list, uint32_t clear_color, DirtyTracker& tracker);
+void render_draw_list_dirty(IndexedBuffer* buffer, const DrawList& list, uint32_t clear_index, DirtyTracker& tracker);
+
+// Splits the buffer into horizontal bands, bins the commands by the rows
+// they touch and clears and draws each band on the pool. Output is
+// identical to render_draw_list.
+struct BandRenderer
+{
+    ThreadPool* pool;
+    size_t num_bands;
+    uint32_t* bin_offsets;
+    uint32_t* bin_commands;
+    size_t bin_capacity;
+
+    // Per-frame job state read by the workers; one of the buffers is set
+    Buffer* buffer;
+    IndexedBuffer* indexed_buffer;
+    const DrawList* list;
+    uint32_t clear_color;
+    size_t height;
+    size_t band_height;
+};
+
+// num_threads as for thread_pool_create; num_bands 0 picks four per thread
+void band_renderer_init(BandRenderer& renderer, size_t num_threads, size_t num_bands);
+void band_renderer_destroy(BandRenderer& renderer);
+void render_draw_list_banded(BandRenderer& renderer, Buffer* buffer, const DrawList& list, uint32_t clear_color);
+void render_draw_list_banded(BandRenderer& renderer, IndexedBuffer* buffer, const DrawList& list, uint32_t clear_index);
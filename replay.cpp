@@ -0,0 +1,222 @@
+#include "replay.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const char RECORDING_MAGIC[4] = {'S', 'I', 'R', 'P'};
+static const uint8_t RECORDING_VERSION = 2;
+
+static uint8_t pack_input(const Input& input)
+{
+    return (uint8_t)((input.move_dir + 2) & 0x7) | (input.fire_pressed ? 0x8 : 0);
+}
+
+static Input unpack_input(uint8_t state)
+{
+    Input input;
+    input.move_dir = (int)(state & 0x7) - 2;
+    input.fire_pressed = (state & 0x8) != 0;
+    return input;
+}
+
+void input_recording_init(InputRecording& recording, const GameConfig& config)
+{
+    recording = {};
+    recording.config = config;
+}
+
+void input_recording_destroy(InputRecording& recording)
+{
+    delete[] recording.runs;
+    recording = {};
+}
+
+void input_recording_push(InputRecording& recording, const Input& input)
+{
+    uint8_t state = pack_input(input);
+    ++recording.num_ticks;
+
+    // A run that has reached the most its length can hold is closed and the
+    // same state starts a new one
+    if(recording.num_runs && recording.runs[recording.num_runs - 1].state == state &&
+       recording.runs[recording.num_runs - 1].length < UINT32_MAX)
+    {
+        ++recording.runs[recording.num_runs - 1].length;
+        return;
+    }
+
+    if(recording.num_runs == recording.capacity)
+    {
+        size_t capacity = recording.capacity ? 2 * recording.capacity : 256;
+        InputRun* runs = new InputRun[capacity];
+        if(recording.num_runs) memcpy(runs, recording.runs, recording.num_runs * sizeof(InputRun));
+        delete[] recording.runs;
+        recording.runs = runs;
+        recording.capacity = capacity;
+    }
+
+    recording.runs[recording.num_runs].length = 1;
+    recording.runs[recording.num_runs].state = state;
+    ++recording.num_runs;
+}
+
+void write_varint(FILE* file, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        fputc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
+
+bool read_varint(FILE* file, uint64_t& value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64; shift += 7)
+    {
+        int byte = fgetc(file);
+        if(byte == EOF) return false;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool input_recording_save(const InputRecording& recording, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Error opening %s for writing.\n", path);
+        return false;
+    }
+
+    fwrite(RECORDING_MAGIC, 1, sizeof(RECORDING_MAGIC), file);
+    fputc(RECORDING_VERSION, file);
+    write_varint(file, recording.config.width);
+    write_varint(file, recording.config.height);
+    write_varint(file, recording.config.alien_rows);
+    write_varint(file, recording.config.alien_cols);
+    write_varint(file, recording.config.max_bullets);
+    write_varint(file, recording.num_ticks);
+    write_varint(file, recording.num_runs);
+    for(size_t i = 0; i < recording.num_runs; ++i)
+    {
+        write_varint(file, recording.runs[i].length);
+        fputc(recording.runs[i].state, file);
+    }
+    for(size_t i = 0; i < 8; ++i)
+    {
+        fputc((int)((recording.final_checksum >> (8 * i)) & 0xff), file);
+    }
+
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if(!ok) fprintf(stderr, "Error writing %s.\n", path);
+    return ok;
+}
+
+bool input_recording_load(InputRecording& recording, const char* path)
+{
+    input_recording_init(recording);
+
+    FILE* file = fopen(path, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Error opening %s for reading.\n", path);
+        return false;
+    }
+
+    char magic[4];
+    int version = 0;
+    bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+              memcmp(magic, RECORDING_MAGIC, sizeof(magic)) == 0 &&
+              (version = fgetc(file)) >= 1 && version <= RECORDING_VERSION;
+
+    if(ok && version >= 2)
+    {
+        uint64_t config[5];
+        for(size_t i = 0; i < 5 && ok; ++i) ok = read_varint(file, config[i]);
+        recording.config = {config[0], config[1], config[2], config[3], config[4]};
+    }
+
+    uint64_t num_ticks = 0, num_runs = 0;
+    ok = ok && read_varint(file, num_ticks) && read_varint(file, num_runs) && num_runs <= num_ticks;
+
+    // Every run takes at least two bytes and the checksum eight, so what is
+    // left of the file bounds the run count before anything is allocated
+    if(ok)
+    {
+        long position = ftell(file);
+        ok = position >= 0 && fseek(file, 0, SEEK_END) == 0;
+        long size = ok ? ftell(file) : -1;
+        ok = ok && size >= position + 8 && fseek(file, position, SEEK_SET) == 0 &&
+             num_runs <= (uint64_t)(size - position - 8) / 2;
+    }
+
+    if(ok)
+    {
+        recording.runs = new InputRun[num_runs];
+        recording.capacity = num_runs;
+
+        uint64_t total = 0;
+        for(size_t i = 0; i < num_runs && ok; ++i)
+        {
+            uint64_t length;
+            int state;
+            ok = read_varint(file, length) && (state = fgetc(file)) != EOF &&
+                 length > 0 && length <= UINT32_MAX;
+            if(ok)
+            {
+                recording.runs[i].length = (uint32_t)length;
+                recording.runs[i].state = (uint8_t)state;
+                total += length;
+            }
+        }
+        recording.num_runs = num_runs;
+        recording.num_ticks = num_ticks;
+        ok = ok && total == num_ticks;
+    }
+
+    for(size_t i = 0; i < 8 && ok; ++i)
+    {
+        int byte = fgetc(file);
+        ok = byte != EOF;
+        recording.final_checksum |= (uint64_t)(byte & 0xff) << (8 * i);
+    }
+
+    fclose(file);
+
+    if(!ok)
+    {
+        fprintf(stderr, "Error reading input recording %s.\n", path);
+        input_recording_destroy(recording);
+    }
+
+    return ok;
+}
+
+void input_playback_init(InputPlayback& playback, const InputRecording& recording)
+{
+    playback.recording = &recording;
+    playback.run = 0;
+    playback.offset = 0;
+}
+
+bool input_playback_next(InputPlayback& playback, Input& input)
+{
+    const InputRecording& recording = *playback.recording;
+    if(playback.run >= recording.num_runs) return false;
+
+    const InputRun& run = recording.runs[playback.run];
+    input = unpack_input(run.state);
+
+    if(++playback.offset == run.length)
+    {
+        ++playback.run;
+        playback.offset = 0;
+    }
+
+    return true;
+}
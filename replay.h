@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "game.h"
+
+// Per-tick input packed into one byte: move_dir + 2 in the low bits and
+// fire in bit 3
+struct InputRun
+{
+    uint32_t length;
+    uint8_t state;
+};
+
+// Run-length encoded input log. Held in memory while recording and written
+// to disk as:
+//
+//   "SIRP" | version u8
+//   | width varint | height varint | alien_rows varint | alien_cols varint
+//   | max_bullets varint | num_ticks varint | num_runs varint
+//   | (length varint, state u8) * num_runs | final sim checksum u64 LE
+//
+// The config is the one the session ran with; version 1 files have none and
+// load with the default. The checksum is world_checksum after the last
+// tick, so a replay can confirm it reproduced the session bit for bit.
+struct InputRecording
+{
+    GameConfig config;
+    size_t num_ticks;
+    size_t num_runs, capacity;
+    InputRun* runs;
+    uint64_t final_checksum;
+};
+
+void input_recording_init(InputRecording& recording, const GameConfig& config = DEFAULT_GAME_CONFIG);
+void input_recording_destroy(InputRecording& recording);
+void input_recording_push(InputRecording& recording, const Input& input);
+
+// LEB128 varints, as used by this and the other file formats
+void write_varint(FILE* file, uint64_t value);
+bool read_varint(FILE* file, uint64_t& value);
+
+bool input_recording_save(const InputRecording& recording, const char* path);
+bool input_recording_load(InputRecording& recording, const char* path);
+
+struct InputPlayback
+{
+    const InputRecording* recording;
+    size_t run;
+    uint32_t offset;
+};
+
+void input_playback_init(InputPlayback& playback, const InputRecording& recording);
+// Returns false once every recorded tick has been played
+bool input_playback_next(InputPlayback& playback, Input& input);
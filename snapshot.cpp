@@ -0,0 +1,349 @@
+#include "snapshot.h"
+#include "profiler.h"
+
+#include <cstring>
+
+constexpr size_t STATE_WORD = sizeof(uint64_t);
+
+static size_t round_to_word(size_t size)
+{
+    return (size + STATE_WORD - 1) / STATE_WORD * STATE_WORD;
+}
+
+// Offsets of the alien and bullet arrays within a state block
+struct StateLayout
+{
+    size_t slot, generation, x, y, type, death_timer;
+    size_t bullet_x, bullet_y, bullet_dir;
+    size_t size;
+};
+
+static StateLayout state_layout(size_t num_aliens, size_t max_bullets)
+{
+    StateLayout layout;
+    layout.slot = round_to_word(sizeof(WorldStateHeader));
+    layout.generation = layout.slot + round_to_word(num_aliens * sizeof(uint32_t));
+    layout.x = layout.generation + round_to_word(num_aliens * sizeof(uint32_t));
+    layout.y = layout.x + round_to_word(num_aliens * sizeof(int16_t));
+    layout.type = layout.y + round_to_word(num_aliens * sizeof(int16_t));
+    layout.death_timer = layout.type + round_to_word(num_aliens * sizeof(uint8_t));
+    layout.bullet_x = layout.death_timer + round_to_word(num_aliens * sizeof(uint8_t));
+    layout.bullet_y = layout.bullet_x + round_to_word(max_bullets * sizeof(int16_t));
+    layout.bullet_dir = layout.bullet_y + round_to_word(max_bullets * sizeof(int16_t));
+    layout.size = layout.bullet_dir + round_to_word(max_bullets * sizeof(int16_t));
+    return layout;
+}
+
+size_t world_state_size(size_t num_aliens, size_t max_bullets)
+{
+    return state_layout(num_aliens, max_bullets).size;
+}
+
+// Copies the live bullets and zeroes the rest of the array, so bullets that
+// have gone leave no words behind for the deltas to carry
+static void save_bullet_array(uint8_t* dst, const int16_t* src, size_t count, size_t max_count)
+{
+    memcpy(dst, src, count * sizeof(int16_t));
+    memset(dst + count * sizeof(int16_t), 0, (max_count - count) * sizeof(int16_t));
+}
+
+void world_state_save(const World& world, uint8_t* block)
+{
+    const Game& game = world.game;
+    const AlienStore& aliens = game.aliens;
+    const BulletStore& bullets = game.bullets;
+    StateLayout layout = state_layout(aliens.count, bullets.max_count);
+
+    WorldStateHeader* header = (WorldStateHeader*)block;
+    header->tick = game.tick;
+    header->last_alien_drop_tick = game.last_alien_drop_tick;
+    header->num_aliens = aliens.count;
+    header->config = world.config;
+    header->num_live_aliens = aliens.num_live;
+    header->num_shown_aliens = aliens.num_shown;
+    header->formation_offset_x = game.formation.offset_x;
+    header->formation_offset_y = game.formation.offset_y;
+    header->prev_player_x = world.prev_player_x;
+    header->player = game.player;
+    header->animation_clock = world.animation_clock;
+    header->num_bullets = bullets.count;
+    header->max_bullets = bullets.max_count;
+    header->bunkers = game.bunkers;
+
+    memcpy(block + layout.slot, aliens.slot, aliens.count * sizeof(uint32_t));
+    memcpy(block + layout.generation, aliens.generation, aliens.count * sizeof(uint32_t));
+    memcpy(block + layout.x, aliens.x, aliens.count * sizeof(int16_t));
+    memcpy(block + layout.y, aliens.y, aliens.count * sizeof(int16_t));
+    memcpy(block + layout.type, aliens.type, aliens.count * sizeof(uint8_t));
+    memcpy(block + layout.death_timer, aliens.death_timer, aliens.count * sizeof(uint8_t));
+
+    save_bullet_array(block + layout.bullet_x, bullets.x, bullets.count, bullets.max_count);
+    save_bullet_array(block + layout.bullet_y, bullets.y, bullets.count, bullets.max_count);
+    save_bullet_array(block + layout.bullet_dir, bullets.dir, bullets.count, bullets.max_count);
+}
+
+bool world_state_load(World& world, const uint8_t* block)
+{
+    Game& game = world.game;
+    AlienStore& aliens = game.aliens;
+    BulletStore& bullets = game.bullets;
+    const WorldStateHeader* header = (const WorldStateHeader*)block;
+    if(header->num_aliens != aliens.count || header->max_bullets != bullets.max_count) return false;
+    if(!game_config_equal(header->config, world.config)) return false;
+    if(!bullet_store_reserve(bullets, header->num_bullets)) return false;
+
+    StateLayout layout = state_layout(aliens.count, bullets.max_count);
+    game.tick = header->tick;
+    game.last_alien_drop_tick = header->last_alien_drop_tick;
+    aliens.num_live = header->num_live_aliens;
+    aliens.num_shown = header->num_shown_aliens;
+    game.formation.offset_x = header->formation_offset_x;
+    game.formation.offset_y = header->formation_offset_y;
+    world.prev_player_x = header->prev_player_x;
+    game.player = header->player;
+    world.animation_clock = header->animation_clock;
+    bullets.count = header->num_bullets;
+
+    // Revisions only tell the renderer a mask changed, so they move forward
+    // even when the masks go back
+    uint32_t revision[GAME_MAX_BUNKERS];
+    memcpy(revision, game.bunkers.revision, sizeof(revision));
+    game.bunkers = header->bunkers;
+    for(size_t i = 0; i < GAME_MAX_BUNKERS; ++i) game.bunkers.revision[i] = revision[i] + 1;
+
+    memcpy(aliens.slot, block + layout.slot, aliens.count * sizeof(uint32_t));
+    memcpy(aliens.generation, block + layout.generation, aliens.count * sizeof(uint32_t));
+    memcpy(aliens.x, block + layout.x, aliens.count * sizeof(int16_t));
+    memcpy(aliens.y, block + layout.y, aliens.count * sizeof(int16_t));
+    memcpy(aliens.type, block + layout.type, aliens.count * sizeof(uint8_t));
+    memcpy(aliens.death_timer, block + layout.death_timer, aliens.count * sizeof(uint8_t));
+    memcpy(bullets.x, block + layout.bullet_x, bullets.count * sizeof(int16_t));
+    memcpy(bullets.y, block + layout.bullet_y, bullets.count * sizeof(int16_t));
+    memcpy(bullets.dir, block + layout.bullet_dir, bullets.count * sizeof(int16_t));
+
+    for(size_t ai = 0; ai < aliens.count; ++ai) aliens.slot_index[aliens.slot[ai]] = (uint32_t)ai;
+    world_rebuild_alien_index(world);
+    return true;
+}
+
+// A delta is a sequence of runs, each a header followed by num_words words
+// to copy to word_offset
+struct DeltaRun
+{
+    uint32_t word_offset;
+    uint32_t num_words;
+};
+
+static uint64_t load_word(const uint8_t* block, size_t word)
+{
+    uint64_t value;
+    memcpy(&value, block + word * STATE_WORD, STATE_WORD);
+    return value;
+}
+
+// Encodes the words of target that differ from base. A single unchanged
+// word between two changes costs as much as a new run header, so it is
+// folded into the run.
+static size_t delta_encode(const uint8_t* target, const uint8_t* base, size_t size, uint8_t* out)
+{
+    size_t num_words = size / STATE_WORD;
+    size_t out_size = 0;
+    size_t word = 0;
+
+    while(word < num_words)
+    {
+        if(load_word(target, word) == load_word(base, word))
+        {
+            ++word;
+            continue;
+        }
+
+        size_t begin = word;
+        size_t end = word + 1;
+        while(end < num_words)
+        {
+            if(load_word(target, end) != load_word(base, end)) ++end;
+            else if(end + 1 < num_words && load_word(target, end + 1) != load_word(base, end + 1)) end += 2;
+            else break;
+        }
+
+        DeltaRun run = {(uint32_t)begin, (uint32_t)(end - begin)};
+        memcpy(out + out_size, &run, sizeof(run));
+        out_size += sizeof(run);
+        memcpy(out + out_size, target + begin * STATE_WORD, run.num_words * STATE_WORD);
+        out_size += run.num_words * STATE_WORD;
+        word = end + 1;
+    }
+
+    return out_size;
+}
+
+static void delta_apply(uint8_t* block, const uint8_t* delta, size_t size)
+{
+    size_t offset = 0;
+    while(offset < size)
+    {
+        DeltaRun run;
+        memcpy(&run, delta + offset, sizeof(run));
+        offset += sizeof(run);
+        memcpy(block + run.word_offset * STATE_WORD, delta + offset, run.num_words * STATE_WORD);
+        offset += run.num_words * STATE_WORD;
+    }
+}
+
+void snapshot_ring_init(SnapshotRing& ring, size_t num_aliens, size_t max_bullets, size_t max_ticks, size_t pool_bytes)
+{
+    ring.state_size = world_state_size(num_aliens, max_bullets);
+    // Runs are at least two unchanged words apart, so there is at most one
+    // header per three words
+    size_t num_words = ring.state_size / STATE_WORD;
+    ring.max_delta_size = ring.state_size + (num_words / 3 + 1) * sizeof(DeltaRun);
+
+    if(!pool_bytes) pool_bytes = max_ticks * ring.state_size;
+    if(pool_bytes < ring.max_delta_size) pool_bytes = ring.max_delta_size;
+
+    ring.max_deltas = max_ticks ? max_ticks : 1;
+    ring.newest = new uint8_t[ring.state_size]();
+    ring.next = new uint8_t[ring.state_size]();
+    ring.scratch = new uint8_t[ring.max_delta_size];
+    ring.deltas = new SnapshotDelta[ring.max_deltas];
+    ring.pool = new uint8_t[pool_bytes];
+    ring.pool_capacity = pool_bytes;
+    snapshot_ring_clear(ring);
+}
+
+void snapshot_ring_destroy(SnapshotRing& ring)
+{
+    delete[] ring.newest;
+    delete[] ring.next;
+    delete[] ring.scratch;
+    delete[] ring.deltas;
+    delete[] ring.pool;
+    ring = {};
+}
+
+void snapshot_ring_clear(SnapshotRing& ring)
+{
+    ring.has_newest = false;
+    ring.newest_tick = 0;
+    ring.first_delta = 0;
+    ring.num_deltas = 0;
+    ring.pool_head = 0;
+}
+
+static const SnapshotDelta& oldest_delta(const SnapshotRing& ring)
+{
+    return ring.deltas[ring.first_delta];
+}
+
+static void drop_oldest_delta(SnapshotRing& ring)
+{
+    ring.first_delta = (ring.first_delta + 1) % ring.max_deltas;
+    --ring.num_deltas;
+}
+
+static bool delta_overlaps(const SnapshotDelta& delta, size_t begin, size_t end)
+{
+    return delta.size && delta.offset < end && delta.offset + delta.size > begin;
+}
+
+// Finds room for size bytes right after the newest delta, wrapping to the
+// start of the pool if the tail is too short. Live deltas always form one
+// arc of the pool from the oldest to pool_head, so the ones in the way are
+// the oldest few.
+static size_t pool_reserve(SnapshotRing& ring, size_t size)
+{
+    if(ring.num_deltas == ring.max_deltas) drop_oldest_delta(ring);
+    if(!ring.num_deltas) ring.pool_head = 0;
+
+    size_t begin = ring.pool_head;
+    bool wrap = begin + size > ring.pool_capacity;
+    if(wrap) begin = 0;
+
+    while(ring.num_deltas)
+    {
+        const SnapshotDelta& oldest = oldest_delta(ring);
+        bool in_tail = wrap && delta_overlaps(oldest, ring.pool_head, ring.pool_capacity);
+        if(!in_tail && !delta_overlaps(oldest, begin, begin + size)) break;
+        drop_oldest_delta(ring);
+    }
+
+    ring.pool_head = begin + size;
+    return begin;
+}
+
+void snapshot_ring_push(SnapshotRing& ring, const World& world)
+{
+    PROFILE_SCOPE(PROFILE_SNAPSHOT_SAVE);
+
+    if(!ring.has_newest)
+    {
+        world_state_save(world, ring.newest);
+        ring.newest_tick = world.game.tick;
+        ring.has_newest = true;
+        return;
+    }
+
+    world_state_save(world, ring.next);
+
+    // The delta goes back from the new state to the current newest
+    size_t size = delta_encode(ring.newest, ring.next, ring.state_size, ring.scratch);
+    size_t offset = pool_reserve(ring, size);
+    memcpy(ring.pool + offset, ring.scratch, size);
+
+    SnapshotDelta& delta = ring.deltas[(ring.first_delta + ring.num_deltas) % ring.max_deltas];
+    delta.tick = ring.newest_tick;
+    delta.offset = offset;
+    delta.size = size;
+    ++ring.num_deltas;
+
+    uint8_t* newest = ring.newest;
+    ring.newest = ring.next;
+    ring.next = newest;
+    ring.newest_tick = world.game.tick;
+}
+
+uint64_t snapshot_ring_oldest_tick(const SnapshotRing& ring)
+{
+    return ring.num_deltas ? oldest_delta(ring).tick : ring.newest_tick;
+}
+
+bool snapshot_ring_rewind(SnapshotRing& ring, uint64_t tick, World& world)
+{
+    PROFILE_SCOPE(PROFILE_SNAPSHOT_REWIND);
+    if(!ring.has_newest || world_state_size(world.game.aliens.count, world.game.bullets.max_count) != ring.state_size) return false;
+
+    // Find the delta for tick before touching anything
+    size_t steps = 0;
+    if(tick != ring.newest_tick)
+    {
+        for(steps = 1; steps <= ring.num_deltas; ++steps)
+        {
+            const SnapshotDelta& delta = ring.deltas[(ring.first_delta + ring.num_deltas - steps) % ring.max_deltas];
+            if(delta.tick == tick) break;
+        }
+        if(steps > ring.num_deltas) return false;
+    }
+
+    // Step back in the spare block, so a state the world refuses leaves
+    // the ring as it was
+    memcpy(ring.next, ring.newest, ring.state_size);
+    for(size_t i = 1; i <= steps; ++i)
+    {
+        const SnapshotDelta& delta = ring.deltas[(ring.first_delta + ring.num_deltas - i) % ring.max_deltas];
+        delta_apply(ring.next, ring.pool + delta.offset, delta.size);
+    }
+    if(!world_state_load(world, ring.next)) return false;
+
+    if(steps)
+    {
+        const SnapshotDelta& target = ring.deltas[(ring.first_delta + ring.num_deltas - steps) % ring.max_deltas];
+        ring.newest_tick = target.tick;
+        ring.pool_head = target.offset;
+        ring.num_deltas -= steps;
+    }
+    uint8_t* newest = ring.newest;
+    ring.newest = ring.next;
+    ring.next = newest;
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "game.h"
+
+// Everything world_tick reads or writes that is not derived from something
+// else, laid out as one flat block:
+//
+//   WorldStateHeader | slot u32[n] | generation u32[n]
+//   | x int16[n] | y int16[n] | type u8[n] | death_timer u8[n]
+//   | bullet x int16[m] | bullet y int16[m] | bullet dir int16[m]
+//
+// with each array padded to 8 bytes, n the alien count and m the bullet
+// cap. Alien entries are kept in their current order and positions are
+// formation-local; bullet entries past the live count are zero. The slot
+// lookup, alien grid and formation tracker are not stored; loading
+// rebuilds them from the alien arrays. Nothing in the game is random, so
+// there is no generator state to keep.
+struct WorldStateHeader
+{
+    uint64_t tick;
+    uint64_t last_alien_drop_tick;
+    uint64_t num_aliens;
+    GameConfig config;
+    uint64_t num_live_aliens, num_shown_aliens;
+    int16_t formation_offset_x, formation_offset_y;
+    uint64_t prev_player_x;
+    Player player;
+    AnimationClock animation_clock;
+    uint64_t num_bullets, max_bullets;
+    BunkerField bunkers;
+};
+
+// Bytes of a state block for num_aliens and a bullet cap of max_bullets,
+// always a multiple of 8
+size_t world_state_size(size_t num_aliens, size_t max_bullets);
+
+// block must be world_state_size bytes and 8-byte aligned. Loading into a
+// world with a different config or alien count fails and leaves it
+// untouched.
+void world_state_save(const World& world, uint8_t* block);
+bool world_state_load(World& world, const uint8_t* block);
+
+// Where one delta lives in the ring's byte pool
+struct SnapshotDelta
+{
+    uint64_t tick;
+    size_t offset;
+    size_t size;
+};
+
+// Recent history of a world, one state per push. Only the newest state is
+// kept whole; each older one is a delta that turns its successor back into
+// it, stored as runs of changed 8-byte words. A tick changes little of the
+// state, so the deltas are a fraction of a full copy, and stepping back
+// costs only the runs between the newest state and the target.
+//
+// Deltas are packed into a circular byte pool; when it or the entry ring
+// fills up the oldest deltas are dropped. Nothing allocates after init.
+struct SnapshotRing
+{
+    size_t state_size;
+    uint8_t* newest;
+    uint64_t newest_tick;
+    bool has_newest;
+    // The state being pushed or rewound to, before it becomes the newest
+    uint8_t* next;
+    // Holds one delta while it is encoded; sized for the worst case
+    uint8_t* scratch;
+    size_t max_delta_size;
+
+    // Oldest first
+    SnapshotDelta* deltas;
+    size_t max_deltas, first_delta, num_deltas;
+
+    uint8_t* pool;
+    size_t pool_capacity, pool_head;
+};
+
+// Keeps up to max_ticks states before the newest within pool_bytes of
+// deltas; pool_bytes 0 sizes the pool for max_ticks full copies
+void snapshot_ring_init(SnapshotRing& ring, size_t num_aliens, size_t max_bullets, size_t max_ticks, size_t pool_bytes);
+void snapshot_ring_destroy(SnapshotRing& ring);
+void snapshot_ring_clear(SnapshotRing& ring);
+
+// Saves the world's current state as the newest
+void snapshot_ring_push(SnapshotRing& ring, const World& world);
+
+// Oldest tick the ring can still go back to
+uint64_t snapshot_ring_oldest_tick(const SnapshotRing& ring);
+
+// Drops every state newer than tick and loads the world with the state at
+// tick, so simulation can continue from there. Returns false, changing
+// nothing, if no state for tick is held.
+bool snapshot_ring_rewind(SnapshotRing& ring, uint64_t tick, World& world);
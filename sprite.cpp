@@ -0,0 +1,374 @@
+#include "sprite.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void buffer_clear(Buffer* buffer, uint32_t color)
+{
+    for(size_t i = 0; i < buffer->width * buffer->height; ++i)
+    {
+        buffer->data[i] = color;
+    }
+}
+
+void buffer_clear_rows(Buffer* buffer, uint32_t color, size_t row_begin, size_t row_end)
+{
+    uint32_t* data = buffer->data + row_begin * buffer->width;
+    for(size_t i = 0; i < (row_end - row_begin) * buffer->width; ++i)
+    {
+        data[i] = color;
+    }
+}
+
+void buffer_clear_rect(Buffer* buffer, uint32_t color, size_t x, size_t y, size_t width, size_t height)
+{
+    uint32_t* row = buffer->data + y * buffer->width + x;
+    for(size_t yi = 0; yi < height; ++yi, row += buffer->width)
+    {
+        for(size_t xi = 0; xi < width; ++xi)
+        {
+            row[xi] = color;
+        }
+    }
+}
+
+void buffer_clear(IndexedBuffer* buffer, uint8_t index)
+{
+    memset(buffer->data, index, buffer->width * buffer->height);
+}
+
+void buffer_clear_rows(IndexedBuffer* buffer, uint8_t index, size_t row_begin, size_t row_end)
+{
+    memset(buffer->data + row_begin * buffer->width, index, (row_end - row_begin) * buffer->width);
+}
+
+void buffer_clear_rect(IndexedBuffer* buffer, uint8_t index, size_t x, size_t y, size_t width, size_t height)
+{
+    uint8_t* row = buffer->data + y * buffer->width + x;
+    for(size_t yi = 0; yi < height; ++yi, row += buffer->width)
+    {
+        memset(row, index, width);
+    }
+}
+
+void indexed_buffer_resolve(const IndexedBuffer& src, const uint32_t* palette, Buffer* dst)
+{
+    for(size_t i = 0; i < src.width * src.height; ++i)
+    {
+        dst->data[i] = palette[src.data[i]];
+    }
+}
+
+bool sprite_boxes_overlap(
+    const PackedSprite& sp_a, size_t x_a, size_t y_a,
+    const PackedSprite& sp_b, size_t x_b, size_t y_b
+)
+{
+    return x_a < x_b + sp_b.width && x_a + sp_a.width > x_b &&
+           y_a < y_b + sp_b.height && y_a + sp_a.height > y_b;
+}
+
+bool sprite_overlap_check(
+    const Sprite& sp_a, size_t x_a, size_t y_a,
+    const Sprite& sp_b, size_t x_b, size_t y_b
+)
+{
+    return sprite_overlap_check(sp_a.packed, x_a, y_a, sp_b.packed, x_b, y_b);
+}
+
+bool sprite_overlap_check(
+    const PackedSprite& sp_a, size_t x_a, size_t y_a,
+    const PackedSprite& sp_b, size_t x_b, size_t y_b
+)
+{
+    if(!sprite_boxes_overlap(sp_a, x_a, y_a, sp_b, x_b, y_b)) return false;
+
+    // Where b sits relative to a. The rectangles intersect, so the offsets
+    // are under either width and the shifts stay below 64.
+    ptrdiff_t dx = (ptrdiff_t)(x_b - x_a);
+    ptrdiff_t dy = (ptrdiff_t)(y_b - y_a);
+    size_t row_begin = dy > 0 ? dy : 0;
+    size_t row_end = std::min<ptrdiff_t>(sp_a.height, dy + (ptrdiff_t)sp_b.height);
+
+    if(dx >= 0)
+    {
+        for(size_t row = row_begin; row < row_end; ++row)
+        {
+            if(sp_a.rows[row] & (sp_b.rows[row - dy] << dx)) return true;
+        }
+    }
+    else
+    {
+        for(size_t row = row_begin; row < row_end; ++row)
+        {
+            if(sp_a.rows[row] & (sp_b.rows[row - dy] >> -dx)) return true;
+        }
+    }
+
+    return false;
+}
+
+void buffer_draw_sprite(Buffer* buffer, const Sprite& sprite, size_t x, size_t y, uint32_t color)
+{
+    for(size_t xi = 0; xi < sprite.width; ++xi)
+    {
+        for(size_t yi = 0; yi < sprite.height; ++yi)
+        {
+            if(sprite.data[yi * sprite.width + xi] &&
+               (sprite.height - 1 + y - yi) < buffer->height &&
+               (x + xi) < buffer->width)
+            {
+                buffer->data[(sprite.height - 1 + y - yi) * buffer->width + (x + xi)] = color;
+            }
+        }
+    }
+}
+
+uint32_t rgb_to_uint32(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (r << 24) | (g << 16) | (b << 8) | 255;
+}
+
+
+bool pack_sprite(Sprite& sprite)
+{
+    PackedSprite& packed = sprite.packed;
+    packed = {};
+
+    if(sprite.width > PACKED_SPRITE_MAX_WIDTH || sprite.height > PACKED_SPRITE_MAX_HEIGHT)
+    {
+        return false;
+    }
+
+    packed.width = sprite.width;
+    packed.height = sprite.height;
+
+    size_t min_x = PACKED_SPRITE_MAX_WIDTH, max_x = 0;
+    size_t min_y = PACKED_SPRITE_MAX_HEIGHT, max_y = 0;
+
+    for(size_t row = 0; row < sprite.height; ++row)
+    {
+        size_t yi = sprite.height - 1 - row;
+        uint64_t mask = 0;
+        for(size_t xi = 0; xi < sprite.width; ++xi)
+        {
+            if(sprite.data[yi * sprite.width + xi]) mask |= 1ull << xi;
+        }
+        packed.rows[row] = mask;
+
+        if(mask)
+        {
+            min_x = std::min(min_x, (size_t)__builtin_ctzll(mask));
+            max_x = std::max(max_x, (size_t)(63 - __builtin_clzll(mask)));
+            min_y = std::min(min_y, row);
+            max_y = row;
+        }
+    }
+
+    if(min_y <= max_y)
+    {
+        packed.bounds_x = min_x;
+        packed.bounds_y = min_y;
+        packed.bounds_width = max_x - min_x + 1;
+        packed.bounds_height = max_y - min_y + 1;
+    }
+
+    return true;
+}
+
+// Writes color to dst[i] for every set bit i of mask. All set bits lie
+// within [0, span), which is inside the clipped row.
+static inline void blit_row_mask(uint32_t* dst, uint64_t mask, size_t span, uint32_t color)
+{
+#if defined(__AVX2__)
+    const __m256i bit_select = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i color_v = _mm256_set1_epi32(color);
+    (void)span;
+
+    for(size_t i = 0; mask; i += 8, mask >>= 8)
+    {
+        int bits = mask & 0xff;
+        if(!bits) continue;
+        if(bits == 0xff)
+        {
+            _mm256_storeu_si256((__m256i*)(dst + i), color_v);
+            continue;
+        }
+
+        __m256i lanes = _mm256_and_si256(_mm256_set1_epi32(bits), bit_select);
+        lanes = _mm256_cmpeq_epi32(lanes, bit_select);
+        _mm256_maskstore_epi32((int*)(dst + i), lanes, color_v);
+    }
+#elif defined(__SSE2__)
+    const __m128i bit_select = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i color_v = _mm_set1_epi32(color);
+
+    // SSE2 has no cheap masked store, so blend with a load and store the
+    // whole group. Only do that for groups fully inside the clipped span so
+    // nothing outside it is ever touched.
+    size_t i = 0;
+    for(; i + 4 <= span && mask; i += 4, mask >>= 4)
+    {
+        int bits = mask & 0xf;
+        if(!bits) continue;
+        if(bits == 0xf)
+        {
+            _mm_storeu_si128((__m128i*)(dst + i), color_v);
+            continue;
+        }
+
+        __m128i lanes = _mm_and_si128(_mm_set1_epi32(bits), bit_select);
+        lanes = _mm_cmpeq_epi32(lanes, bit_select);
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(dst + i));
+        pixels = _mm_or_si128(_mm_and_si128(lanes, color_v), _mm_andnot_si128(lanes, pixels));
+        _mm_storeu_si128((__m128i*)(dst + i), pixels);
+    }
+
+    for(; mask; mask &= mask - 1)
+    {
+        dst[i + __builtin_ctzll(mask)] = color;
+    }
+#else
+    (void)span;
+    for(; mask; mask &= mask - 1)
+    {
+        dst[__builtin_ctzll(mask)] = color;
+    }
+#endif
+}
+
+// Same for a row of palette indices
+static inline void blit_row_mask(uint8_t* dst, uint64_t mask, size_t span, uint8_t index)
+{
+#if defined(__SSE2__)
+    const __m128i bit_select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i index_v = _mm_set1_epi8(index);
+
+    // Sixteen pixels per group, blended with a load like the SSE2 colour
+    // path and only for groups fully inside the clipped span
+    size_t i = 0;
+    for(; i + 16 <= span && mask; i += 16, mask >>= 16)
+    {
+        int bits = mask & 0xffff;
+        if(!bits) continue;
+        if(bits == 0xffff)
+        {
+            _mm_storeu_si128((__m128i*)(dst + i), index_v);
+            continue;
+        }
+
+        // Low byte of bits into lanes 0-7, high byte into lanes 8-15
+        __m128i lanes = _mm_cvtsi32_si128(bits);
+        lanes = _mm_unpacklo_epi8(lanes, lanes);
+        lanes = _mm_unpacklo_epi16(lanes, lanes);
+        lanes = _mm_unpacklo_epi32(lanes, lanes);
+        lanes = _mm_cmpeq_epi8(_mm_and_si128(lanes, bit_select), bit_select);
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(dst + i));
+        pixels = _mm_or_si128(_mm_and_si128(lanes, index_v), _mm_andnot_si128(lanes, pixels));
+        _mm_storeu_si128((__m128i*)(dst + i), pixels);
+    }
+
+    for(; mask; mask &= mask - 1)
+    {
+        dst[i + __builtin_ctzll(mask)] = index;
+    }
+#else
+    (void)span;
+    for(; mask; mask &= mask - 1)
+    {
+        dst[__builtin_ctzll(mask)] = index;
+    }
+#endif
+}
+
+// Clips once against the rectangle and blits row by row, for either pixel type
+template <typename Pixel>
+static void draw_packed_sprite_rect(
+    Pixel* data, size_t stride, const PackedSprite& sprite, size_t x, size_t y, Pixel color,
+    size_t clip_x, size_t clip_y, size_t clip_width, size_t clip_height
+)
+{
+    if(sprite.bounds_width == 0) return;
+
+    // Positions that went "negative" wrapped around as size_t
+    ptrdiff_t left = (ptrdiff_t)x + (ptrdiff_t)sprite.bounds_x;
+    ptrdiff_t bottom = (ptrdiff_t)y + (ptrdiff_t)sprite.bounds_y;
+
+    ptrdiff_t col_begin = std::max<ptrdiff_t>(0, (ptrdiff_t)clip_x - left);
+    ptrdiff_t col_end = std::min<ptrdiff_t>(sprite.bounds_width, (ptrdiff_t)(clip_x + clip_width) - left);
+    ptrdiff_t row_begin = std::max<ptrdiff_t>(0, (ptrdiff_t)clip_y - bottom);
+    ptrdiff_t row_end = std::min<ptrdiff_t>(sprite.bounds_height, (ptrdiff_t)(clip_y + clip_height) - bottom);
+
+    if(col_begin >= col_end || row_begin >= row_end) return;
+
+    size_t span = col_end - col_begin;
+    uint64_t clip = span == 64 ? ~0ull : (1ull << span) - 1;
+    size_t shift = sprite.bounds_x + col_begin;
+
+    Pixel* dst = data + (bottom + row_begin) * stride + (left + col_begin);
+    for(ptrdiff_t row = row_begin; row < row_end; ++row, dst += stride)
+    {
+        uint64_t mask = (sprite.rows[sprite.bounds_y + row] >> shift) & clip;
+        blit_row_mask(dst, mask, span, color);
+    }
+}
+
+void buffer_draw_packed_sprite(Buffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint32_t color)
+{
+    buffer_draw_packed_sprite_rows(buffer, sprite, x, y, color, 0, buffer->height);
+}
+
+void buffer_draw_packed_sprite_rows(
+    Buffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint32_t color,
+    size_t clip_row_begin, size_t clip_row_end
+)
+{
+    buffer_draw_packed_sprite_rect(
+        buffer, sprite, x, y, color,
+        0, clip_row_begin, buffer->width, clip_row_end - clip_row_begin
+    );
+}
+
+void buffer_draw_packed_sprite_rect(
+    Buffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint32_t color,
+    size_t clip_x, size_t clip_y, size_t clip_width, size_t clip_height
+)
+{
+    draw_packed_sprite_rect(
+        buffer->data, buffer->width, sprite, x, y, color,
+        clip_x, clip_y, clip_width, clip_height
+    );
+}
+
+void buffer_draw_packed_sprite(IndexedBuffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint8_t index)
+{
+    buffer_draw_packed_sprite_rows(buffer, sprite, x, y, index, 0, buffer->height);
+}
+
+void buffer_draw_packed_sprite_rows(
+    IndexedBuffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint8_t index,
+    size_t clip_row_begin, size_t clip_row_end
+)
+{
+    buffer_draw_packed_sprite_rect(
+        buffer, sprite, x, y, index,
+        0, clip_row_begin, buffer->width, clip_row_end - clip_row_begin
+    );
+}
+
+void buffer_draw_packed_sprite_rect(
+    IndexedBuffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint8_t index,
+    size_t clip_x, size_t clip_y, size_t clip_width, size_t clip_height
+)
+{
+    draw_packed_sprite_rect(
+        buffer->data, buffer->width, sprite, x, y, index,
+        clip_x, clip_y, clip_width, clip_height
+    );
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct Buffer
+{
+    size_t width, height;
+    uint32_t* data;
+};
+
+// Palette indices instead of colours, laid out like Buffer. A quarter of
+// the bytes to clear, draw and upload.
+struct IndexedBuffer
+{
+    size_t width, height;
+    uint8_t* data;
+};
+
+constexpr size_t PALETTE_SIZE = 256;
+
+constexpr size_t PACKED_SPRITE_MAX_WIDTH = 64;
+constexpr size_t PACKED_SPRITE_MAX_HEIGHT = 32;
+
+// 1-bit sprite, one mask per row. Rows are stored bottom-up in buffer order
+// (rows[0] lands on the lowest buffer row) and bit i of a row is column i,
+// so a blit walks both the sprite and the buffer forwards.
+struct PackedSprite
+{
+    size_t width, height;
+    // Tight bounds of the set pixels, in the same bottom-up space as rows
+    size_t bounds_x, bounds_y, bounds_width, bounds_height;
+    uint64_t rows[PACKED_SPRITE_MAX_HEIGHT];
+};
+
+struct Sprite
+{
+    size_t width, height;
+    const uint8_t* data;
+    PackedSprite packed;
+};
+
+void buffer_clear(Buffer* buffer, uint32_t color);
+void buffer_clear_rows(Buffer* buffer, uint32_t color, size_t row_begin, size_t row_end);
+// Rectangle must lie inside the buffer
+void buffer_clear_rect(Buffer* buffer, uint32_t color, size_t x, size_t y, size_t width, size_t height);
+// Whether the sprites' rectangles intersect, ignoring transparent pixels
+bool sprite_boxes_overlap(
+    const PackedSprite& sp_a, size_t x_a, size_t y_a,
+    const PackedSprite& sp_b, size_t x_b, size_t y_b
+);
+// Whether any set pixels coincide. Once the rectangles intersect, each
+// shared row is one shift and AND of the row masks, stopping at the first
+// hit. The Sprite overload tests the packed copies, so they must be built.
+bool sprite_overlap_check(
+    const Sprite& sp_a, size_t x_a, size_t y_a,
+    const Sprite& sp_b, size_t x_b, size_t y_b
+);
+bool sprite_overlap_check(
+    const PackedSprite& sp_a, size_t x_a, size_t y_a,
+    const PackedSprite& sp_b, size_t x_b, size_t y_b
+);
+
+// Reference per-pixel blitter working from the byte data
+void buffer_draw_sprite(Buffer* buffer, const Sprite& sprite, size_t x, size_t y, uint32_t color);
+
+// Builds sprite.packed from sprite.data. Returns false if the sprite is
+// larger than PACKED_SPRITE_MAX_WIDTH x PACKED_SPRITE_MAX_HEIGHT.
+bool pack_sprite(Sprite& sprite);
+
+// Row mask blitter: clips once per sprite and fills whole rows with SIMD
+// stores where available. Coordinates that wrapped below zero are treated
+// as negative, matching the clipping of buffer_draw_sprite.
+void buffer_draw_packed_sprite(Buffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint32_t color);
+
+// Same, but only touches buffer rows in [clip_row_begin, clip_row_end)
+void buffer_draw_packed_sprite_rows(
+    Buffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint32_t color,
+    size_t clip_row_begin, size_t clip_row_end
+);
+
+// Same, but only touches the clip rectangle, which must lie inside the buffer
+void buffer_draw_packed_sprite_rect(
+    Buffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint32_t color,
+    size_t clip_x, size_t clip_y, size_t clip_width, size_t clip_height
+);
+
+// The same clears and packed blitters writing palette indices
+void buffer_clear(IndexedBuffer* buffer, uint8_t index);
+void buffer_clear_rows(IndexedBuffer* buffer, uint8_t index, size_t row_begin, size_t row_end);
+void buffer_clear_rect(IndexedBuffer* buffer, uint8_t index, size_t x, size_t y, size_t width, size_t height);
+void buffer_draw_packed_sprite(IndexedBuffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint8_t index);
+void buffer_draw_packed_sprite_rows(
+    IndexedBuffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint8_t index,
+    size_t clip_row_begin, size_t clip_row_end
+);
+void buffer_draw_packed_sprite_rect(
+    IndexedBuffer* buffer, const PackedSprite& sprite, size_t x, size_t y, uint8_t index,
+    size_t clip_x, size_t clip_y, size_t clip_width, size_t clip_height
+);
+
+// Expands every index through palette into dst, which must be the same size
+void indexed_buffer_resolve(const IndexedBuffer& src, const uint32_t* palette, Buffer* dst);
+
+uint32_t rgb_to_uint32(uint8_t r, uint8_t g, uint8_t b);
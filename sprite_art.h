@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sprite.h"
+
+// Compile-time sprite baking. Art is an array of string rows, top row
+// first, with '@' for a set pixel and '.' for a clear one:
+//
+//   constexpr char bullet_art[][2] = {"@", "@", "@"};
+//   static_assert(sprite_art_valid(bullet_art), "...");
+//   constexpr auto bullet_pixels = bake_sprite_pixels(bullet_art);
+//   constexpr Sprite bullet = bake_sprite(bullet_art, bullet_pixels.data);
+//
+// Width and height come from the array type, so they cannot disagree with
+// the data, and everything lands in read-only memory.
+
+template <size_t W, size_t H>
+struct SpritePixels
+{
+    uint8_t data[W * H];
+};
+
+// True if every row is exactly N - 1 pixels of '@' or '.'. A short row is
+// padded with '\0' by the compiler and fails the check.
+template <size_t H, size_t N>
+constexpr bool sprite_art_valid(const char (&art)[H][N])
+{
+    for(size_t yi = 0; yi < H; ++yi)
+    {
+        for(size_t xi = 0; xi + 1 < N; ++xi)
+        {
+            if(art[yi][xi] != '@' && art[yi][xi] != '.') return false;
+        }
+    }
+    return true;
+}
+
+// Byte per pixel, top row first, as buffer_draw_sprite reads it
+template <size_t H, size_t N>
+constexpr SpritePixels<N - 1, H> bake_sprite_pixels(const char (&art)[H][N])
+{
+    SpritePixels<N - 1, H> pixels = {};
+    for(size_t yi = 0; yi < H; ++yi)
+    {
+        for(size_t xi = 0; xi + 1 < N; ++xi)
+        {
+            pixels.data[yi * (N - 1) + xi] = art[yi][xi] == '@';
+        }
+    }
+    return pixels;
+}
+
+// Same layout and bounds as pack_sprite produces at runtime
+template <size_t H, size_t N>
+constexpr PackedSprite bake_packed_sprite(const char (&art)[H][N])
+{
+    static_assert(N > 1 && H > 0, "sprite art must not be empty");
+    static_assert(N - 1 <= PACKED_SPRITE_MAX_WIDTH, "sprite art is wider than PACKED_SPRITE_MAX_WIDTH");
+    static_assert(H <= PACKED_SPRITE_MAX_HEIGHT, "sprite art is taller than PACKED_SPRITE_MAX_HEIGHT");
+
+    PackedSprite packed = {};
+    packed.width = N - 1;
+    packed.height = H;
+
+    size_t min_x = PACKED_SPRITE_MAX_WIDTH, max_x = 0;
+    size_t min_y = PACKED_SPRITE_MAX_HEIGHT, max_y = 0;
+
+    for(size_t row = 0; row < H; ++row)
+    {
+        size_t yi = H - 1 - row;
+        uint64_t mask = 0;
+        for(size_t xi = 0; xi + 1 < N; ++xi)
+        {
+            if(art[yi][xi] == '@')
+            {
+                mask |= 1ull << xi;
+                if(xi < min_x) min_x = xi;
+                if(xi > max_x) max_x = xi;
+            }
+        }
+        packed.rows[row] = mask;
+
+        if(mask)
+        {
+            if(row < min_y) min_y = row;
+            max_y = row;
+        }
+    }
+
+    if(min_y <= max_y)
+    {
+        packed.bounds_x = min_x;
+        packed.bounds_y = min_y;
+        packed.bounds_width = max_x - min_x + 1;
+        packed.bounds_height = max_y - min_y + 1;
+    }
+
+    return packed;
+}
+
+// data must be the art's baked pixels
+template <size_t H, size_t N>
+constexpr Sprite bake_sprite(const char (&art)[H][N], const uint8_t* data)
+{
+    return Sprite{N - 1, H, data, bake_packed_sprite(art)};
+}
@@ -0,0 +1,189 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Remaining indices of one worker packed as begin | end << 32, so the owner
+// (taking from the front) and thieves (taking from the back) can both claim
+// work with a single compare-and-swap. Padded to a cache line so workers
+// do not false-share.
+struct WorkerRange
+{
+    std::atomic<uint64_t> range;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+struct ThreadPool
+{
+    size_t num_workers;
+    std::thread* threads;
+    WorkerRange* ranges;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    uint64_t generation;
+    size_t pending_workers;
+    bool quit;
+
+    ThreadPoolTask task;
+    void* data;
+};
+
+static inline uint64_t pack_range(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)begin | ((uint64_t)end << 32);
+}
+
+static bool pop_front(WorkerRange& worker, size_t& index)
+{
+    uint64_t range = worker.range.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+        if(begin >= end) return false;
+        if(worker.range.compare_exchange_weak(range, pack_range(begin + 1, end), std::memory_order_acq_rel))
+        {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+static bool steal_back(WorkerRange& worker, size_t& index)
+{
+    uint64_t range = worker.range.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+        if(begin >= end) return false;
+        if(worker.range.compare_exchange_weak(range, pack_range(begin, end - 1), std::memory_order_acq_rel))
+        {
+            index = end - 1;
+            return true;
+        }
+    }
+}
+
+static void run_worker(ThreadPool* pool, size_t worker_id)
+{
+    size_t index;
+    for(;;)
+    {
+        if(pop_front(pool->ranges[worker_id], index))
+        {
+            pool->task(pool->data, index);
+            continue;
+        }
+
+        bool stole = false;
+        for(size_t i = 1; i < pool->num_workers && !stole; ++i)
+        {
+            stole = steal_back(pool->ranges[(worker_id + i) % pool->num_workers], index);
+        }
+        if(!stole) return;
+
+        pool->task(pool->data, index);
+    }
+}
+
+static void worker_main(ThreadPool* pool, size_t worker_id)
+{
+    uint64_t seen_generation = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->start_cv.wait(lock, [&]{ return pool->quit || pool->generation != seen_generation; });
+            if(pool->quit) return;
+            seen_generation = pool->generation;
+        }
+
+        run_worker(pool, worker_id);
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if(--pool->pending_workers == 0) pool->done_cv.notify_one();
+    }
+}
+
+ThreadPool* thread_pool_create(size_t num_threads)
+{
+    if(num_threads == 0) num_threads = std::thread::hardware_concurrency();
+    if(num_threads == 0) num_threads = 1;
+
+    ThreadPool* pool = new ThreadPool();
+    pool->num_workers = num_threads;
+    pool->ranges = new WorkerRange[num_threads];
+    pool->generation = 0;
+    pool->pending_workers = 0;
+    pool->quit = false;
+    pool->task = NULL;
+    pool->data = NULL;
+
+    // Worker 0 is whoever calls thread_pool_for
+    pool->threads = new std::thread[num_threads - 1];
+    for(size_t i = 1; i < num_threads; ++i)
+    {
+        pool->threads[i - 1] = std::thread(worker_main, pool, i);
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(ThreadPool* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->start_cv.notify_all();
+
+    for(size_t i = 0; i + 1 < pool->num_workers; ++i)
+    {
+        pool->threads[i].join();
+    }
+
+    delete[] pool->threads;
+    delete[] pool->ranges;
+    delete pool;
+}
+
+size_t thread_pool_size(const ThreadPool* pool)
+{
+    return pool->num_workers;
+}
+
+void thread_pool_for(ThreadPool* pool, size_t count, ThreadPoolTask task, void* data)
+{
+    if(count == 0) return;
+
+    if(pool->num_workers == 1 || count == 1)
+    {
+        for(size_t i = 0; i < count; ++i) task(data, i);
+        return;
+    }
+
+    for(size_t w = 0; w < pool->num_workers; ++w)
+    {
+        uint32_t begin = count * w / pool->num_workers;
+        uint32_t end = count * (w + 1) / pool->num_workers;
+        pool->ranges[w].range.store(pack_range(begin, end), std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->task = task;
+        pool->data = data;
+        pool->pending_workers = pool->num_workers - 1;
+        ++pool->generation;
+    }
+    pool->start_cv.notify_all();
+
+    run_worker(pool, 0);
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done_cv.wait(lock, [&]{ return pool->pending_workers == 0; });
+}
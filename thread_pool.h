@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+// Persistent worker pool for data-parallel loops. Each call splits the
+// index range evenly across the workers; a worker that runs out steals
+// single indices from the back of another worker's range.
+struct ThreadPool;
+
+typedef void (*ThreadPoolTask)(void* data, size_t index);
+
+// num_threads counts the calling thread, which also works during
+// thread_pool_for. 0 picks the hardware concurrency.
+ThreadPool* thread_pool_create(size_t num_threads);
+void thread_pool_destroy(ThreadPool* pool);
+
+size_t thread_pool_size(const ThreadPool* pool);
+
+// Runs task(data, i) for every i in [0, count) and returns once all are done
+void thread_pool_for(ThreadPool* pool, size_t count, ThreadPoolTask task, void* data);
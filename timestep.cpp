@@ -0,0 +1,41 @@
+#include "timestep.h"
+
+#include <chrono>
+
+uint64_t monotonic_time_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void timestep_init(FixedTimestep& timestep, uint64_t tick_ns, size_t max_ticks_per_frame, uint64_t now_ns)
+{
+    timestep.tick_ns = tick_ns;
+    timestep.accumulator_ns = 0;
+    timestep.last_time_ns = now_ns;
+    timestep.max_ticks_per_frame = max_ticks_per_frame;
+    timestep.dropped_ticks = 0;
+}
+
+size_t timestep_advance(FixedTimestep& timestep, uint64_t now_ns)
+{
+    timestep.accumulator_ns += now_ns - timestep.last_time_ns;
+    timestep.last_time_ns = now_ns;
+
+    size_t num_ticks = timestep.accumulator_ns / timestep.tick_ns;
+    timestep.accumulator_ns -= num_ticks * timestep.tick_ns;
+
+    if(num_ticks > timestep.max_ticks_per_frame)
+    {
+        timestep.dropped_ticks += num_ticks - timestep.max_ticks_per_frame;
+        num_ticks = timestep.max_ticks_per_frame;
+    }
+
+    return num_ticks;
+}
+
+double timestep_alpha(const FixedTimestep& timestep)
+{
+    return (double)timestep.accumulator_ns / timestep.tick_ns;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint64_t SIM_TICKS_PER_SECOND = 60;
+constexpr uint64_t SIM_TICK_NS = 1000000000ull / SIM_TICKS_PER_SECOND;
+constexpr size_t SIM_MAX_CATCHUP_TICKS = 5;
+
+// Fixed-timestep scheduler. Wall time is fed in from a monotonic clock and
+// turned into a whole number of simulation ticks; the remainder is kept in
+// the accumulator and exposed as an interpolation factor for rendering.
+struct FixedTimestep
+{
+    uint64_t tick_ns;
+    uint64_t accumulator_ns;
+    uint64_t last_time_ns;
+    size_t max_ticks_per_frame;
+    size_t dropped_ticks;
+};
+
+uint64_t monotonic_time_ns();
+
+void timestep_init(FixedTimestep& timestep, uint64_t tick_ns, size_t max_ticks_per_frame, uint64_t now_ns);
+
+// Returns how many ticks to simulate this frame. If more than
+// max_ticks_per_frame are due, the backlog is dropped instead of spiralling.
+size_t timestep_advance(FixedTimestep& timestep, uint64_t now_ns);
+
+// Fraction of a tick elapsed since the last simulated tick, in [0, 1)
+double timestep_alpha(const FixedTimestep& timestep);